@@ -98,18 +98,33 @@ static struct cfg *make_cfg(void)
 
 	cfg_add_enum(cfg, "pol_driver", EFP_POL_DRIVER_ITERATIVE,
 		"iterative\n"
-		"direct\n",
+		"direct\n"
+		"cg\n"
+		"opt\n",
 		(int []) { EFP_POL_DRIVER_ITERATIVE,
-			   EFP_POL_DRIVER_DIRECT });
+			   EFP_POL_DRIVER_DIRECT,
+			   EFP_POL_DRIVER_CG,
+			   EFP_POL_DRIVER_OPT });
+
+	cfg_add_double(cfg, "pol_scf_tol", 1.0e-10);
+	cfg_add_int(cfg, "pol_scf_max_iter", 80);
+	cfg_add_bool(cfg, "disable_pol_cache", false);
+	cfg_add_int(cfg, "pol_history", 0);
 
 	cfg_add_bool(cfg, "enable_ff", false);
 	cfg_add_bool(cfg, "enable_multistep", false);
+	cfg_add_bool(cfg, "enable_pol_xl", false);
+	cfg_add_int(cfg, "pol_xl_iter", 1);
 	cfg_add_string(cfg, "ff_geometry", "ff.xyz");
 	cfg_add_string(cfg, "ff_parameters", FRAGLIB_PATH "/params/amber99.prm");
 	cfg_add_bool(cfg, "single_params_file", false);
 	cfg_add_string(cfg, "efp_params_file", "params.efp");
 	cfg_add_bool(cfg, "enable_cutoff", false);
 	cfg_add_double(cfg, "swf_cutoff", 10.0);
+	cfg_add_double(cfg, "verlet_skin", 0.0);
+	cfg_add_double(cfg, "xr_int_tol", 1.0e-20);
+	cfg_add_bool(cfg, "enable_work_stealing", false);
+	cfg_add_bool(cfg, "enable_incremental", false);
 	cfg_add_int(cfg, "max_steps", 100);
 	cfg_add_int(cfg, "multistep_steps", 1);
 	cfg_add_string(cfg, "fraglib_path", FRAGLIB_PATH);
@@ -245,9 +260,20 @@ static struct efp *create_efp(const struct cfg *cfg, const struct sys *sys)
 		.disp_damp = cfg_get_enum(cfg, "disp_damp"),
 		.pol_damp = cfg_get_enum(cfg, "pol_damp"),
 		.pol_driver = cfg_get_enum(cfg, "pol_driver"),
+		.pol_scf_tol = cfg_get_double(cfg, "pol_scf_tol"),
+		.pol_scf_max_iter =
+		    (size_t)cfg_get_int(cfg, "pol_scf_max_iter"),
+		.disable_pol_cache = cfg_get_bool(cfg, "disable_pol_cache"),
+		.pol_history = (size_t)cfg_get_int(cfg, "pol_history"),
 		.enable_pbc = cfg_get_bool(cfg, "enable_pbc"),
 		.enable_cutoff = cfg_get_bool(cfg, "enable_cutoff"),
-		.swf_cutoff = cfg_get_double(cfg, "swf_cutoff")
+		.swf_cutoff = cfg_get_double(cfg, "swf_cutoff"),
+		.verlet_skin = cfg_get_double(cfg, "verlet_skin"),
+		.xr_int_tol = cfg_get_double(cfg, "xr_int_tol"),
+		.disable_stress = cfg_get_enum(cfg, "run_type") != RUN_TYPE_MD ||
+		    cfg_get_enum(cfg, "ensemble") != ENSEMBLE_TYPE_NPT,
+		.enable_work_stealing = cfg_get_bool(cfg, "enable_work_stealing"),
+		.enable_incremental = cfg_get_bool(cfg, "enable_incremental")
 	};
 
 	enum efp_coord_type coord_type = cfg_get_enum(cfg, "coord");
@@ -384,6 +410,8 @@ static void convert_units(struct cfg *cfg, struct sys *sys)
 		cfg_get_double(cfg, "pressure") * BAR_TO_AU);
 	cfg_set_double(cfg, "swf_cutoff",
 		cfg_get_double(cfg, "swf_cutoff") / BOHR_RADIUS);
+	cfg_set_double(cfg, "verlet_skin",
+		cfg_get_double(cfg, "verlet_skin") / BOHR_RADIUS);
 	cfg_set_double(cfg, "num_step_dist",
 		cfg_get_double(cfg, "num_step_dist") / BOHR_RADIUS);
 
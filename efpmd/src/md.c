@@ -29,6 +29,32 @@
 
 #define MAX_ITER 10
 
+/*
+ * Extended Lagrangian polarization with dissipation:
+ *
+ * Anders M. N. Niklasson, Peter Steneteg, Anders Odell, Nicolas Bock,
+ * Matt Challacombe, C. J. Tymczak, Erik Holmstrom, Guishan Zheng,
+ * Valery Weber
+ *
+ * Extended Lagrangian Born-Oppenheimer molecular dynamics with dissipation
+ *
+ * J. Chem. Phys. 130, 214109 (2009)
+ *
+ * Alex Albaugh, Omar Demerdash, Teresa Head-Gordon
+ *
+ * An efficient and stable hybrid extended Lagrangian/self-consistent field
+ * scheme for solving classical mutual induction
+ *
+ * J. Chem. Phys. 143, 174104 (2015)
+ */
+#define XL_ORDER 5
+
+static const double xl_kappa = 1.82;
+static const double xl_alpha = 0.018;
+static const double xl_coef[XL_ORDER + 1] = {
+	-6.0, 14.0, -8.0, -3.0, 4.0, -1.0
+};
+
 struct body {
 	mat_t rotmat;
 	vec_t pos;
@@ -63,6 +89,9 @@ struct md {
 	double potential_energy;
 	double xr_energy; /* used in multistep md */
 	double *xr_gradient; /* used in multistep md */
+	size_t n_pol; /* number of induced dipoles */
+	size_t n_pol_hist; /* number of stored auxiliary dipole sets */
+	double *pol_hist; /* auxiliary dipoles of previous steps, newest first */
 	double (*get_invariant)(const struct md *);
 	void (*update_step)(struct md *);
 	struct state *state;
@@ -316,6 +345,54 @@ static void remove_system_drift(struct md *md)
 	assert(vec_len(&cv2) < EPSILON && vec_len(&am2) < EPSILON);
 }
 
+static void set_pol_xl_opts(struct md *md)
+{
+	struct efp_opts opts;
+
+	check_fail(efp_get_opts(md->state->efp, &opts));
+	opts.pol_scf_max_iter = (size_t)cfg_get_int(md->state->cfg,
+	    "pol_xl_iter");
+	opts.pol_history = 0;
+	opts.disable_pol_conv_check = 1;
+	check_fail(efp_set_opts(md->state->efp, &opts));
+}
+
+/* Auxiliary induced dipoles and conjugate induced dipoles are propagated with
+ * time-reversible Verlet integration. They are pulled towards dipoles after
+ * a few solver iterations and a small dissipation term removes accumulated
+ * numerical noise. The first XL_ORDER + 1 steps use converged dipoles. */
+static void update_pol_xl(struct md *md)
+{
+	size_t n = 6 * md->n_pol;
+	double *hist = md->pol_hist;
+	double *dip = xmalloc(n * sizeof(double));
+
+	check_fail(efp_get_induced_dipole_values(md->state->efp, dip));
+	check_fail(efp_get_induced_dipole_conj_values(md->state->efp,
+	    dip + n / 2));
+
+	if (md->n_pol_hist == XL_ORDER + 1) {
+		for (size_t i = 0; i < n; i++) {
+			double sum = 0.0;
+
+			for (size_t k = 0; k <= XL_ORDER; k++)
+				sum += xl_coef[k] * hist[k * n + i];
+
+			dip[i] = 2.0 * hist[i] - hist[n + i] +
+			    xl_kappa * (dip[i] - hist[i]) + xl_alpha * sum;
+		}
+	} else {
+		md->n_pol_hist++;
+
+		if (md->n_pol_hist == XL_ORDER + 1)
+			set_pol_xl_opts(md);
+	}
+
+	memmove(hist + n, hist, XL_ORDER * n * sizeof(double));
+	memcpy(hist, dip, n * sizeof(double));
+	free(dip);
+}
+
 static void compute_forces(struct md *md)
 {
 	for (size_t i = 0; i < md->n_bodies; i++) {
@@ -328,6 +405,13 @@ static void compute_forces(struct md *md)
 		    EFP_COORD_TYPE_ROTMAT, crd));
 	}
 
+	if (md->pol_hist && md->n_pol_hist == XL_ORDER + 1) {
+		check_fail(efp_set_induced_dipole_values(md->state->efp,
+		    md->pol_hist));
+		check_fail(efp_set_induced_dipole_conj_values(md->state->efp,
+		    md->pol_hist + 3 * md->n_pol));
+	}
+
 	if (cfg_get_bool(md->state->cfg, "enable_multistep")) {
 		struct efp_opts opts, opts_save;
 		int multistep_steps;
@@ -354,6 +438,9 @@ static void compute_forces(struct md *md)
 	} else
 		compute_energy(md->state, true);
 
+	if (md->pol_hist)
+		update_pol_xl(md);
+
 	md->potential_energy = md->state->energy;
 
 	for (size_t i = 0; i < md->n_bodies; i++) {
@@ -817,6 +904,20 @@ static struct md *md_create(struct state *state)
 	md->bodies = xcalloc(md->n_bodies, sizeof(struct body));
 	md->xr_gradient = xcalloc(6 * md->n_bodies, sizeof(double));
 
+	if (cfg_get_bool(state->cfg, "enable_pol_xl")) {
+		struct efp_opts opts;
+
+		check_fail(efp_get_opts(state->efp, &opts));
+
+		if (opts.terms & EFP_TERM_POL)
+			check_fail(efp_get_induced_dipole_count(state->efp,
+			    &md->n_pol));
+
+		if (md->n_pol > 0)
+			md->pol_hist = xcalloc((XL_ORDER + 1) * 6 * md->n_pol,
+			    sizeof(double));
+	}
+
 	double coord[6 * md->n_bodies];
 	check_fail(efp_get_coordinates(state->efp, coord));
 
@@ -898,6 +999,7 @@ static void md_shutdown(struct md *md)
 {
 	free(md->bodies);
 	free(md->xr_gradient);
+	free(md->pol_hist);
 	free(md->data);
 	free(md);
 }
@@ -53,6 +53,16 @@ type, bind(c) :: efp_opts
   integer(kind=c_int) enable_pbc
   integer(kind=c_int) enable_cutoff
   real(kind=c_double) swf_cutoff
+  real(kind=c_double) verlet_skin
+  integer(kind=c_int) disable_stress
+  integer(kind=c_int) enable_work_stealing
+  integer(kind=c_int) enable_incremental
+  real(kind=c_double) pol_scf_tol
+  integer(kind=c_size_t) pol_scf_max_iter
+  integer(kind=c_int) disable_pol_cache
+  integer(kind=c_size_t) pol_history
+  integer(kind=c_int) disable_pol_conv_check
+  real(kind=c_double) xr_int_tol
 end type efp_opts
 
 type, bind(c) :: efp_energy
@@ -404,6 +414,22 @@ function efp_get_induced_dipole_conj_values(efp, dip) bind(c)
   type(c_ptr), value :: dip
 end function
 
+! efp_result_t efp_set_induced_dipole_values(struct efp *efp, const double *dip);
+function efp_set_induced_dipole_values(efp, dip) bind(c)
+  use iso_c_binding, only: c_int, c_ptr
+  integer(c_int) :: efp_set_induced_dipole_values
+  type(c_ptr), value :: efp
+  type(c_ptr), value :: dip
+end function
+
+! efp_result_t efp_set_induced_dipole_conj_values(struct efp *efp, const double *dip);
+function efp_set_induced_dipole_conj_values(efp, dip) bind(c)
+  use iso_c_binding, only: c_int, c_ptr
+  integer(c_int) :: efp_set_induced_dipole_conj_values
+  type(c_ptr), value :: efp
+  type(c_ptr), value :: dip
+end function
+
 ! efp_result_t efp_get_lmo_count(struct efp *efp, size_t frag_idx, size_t *n_lmo);
 function efp_get_lmo_count(efp, frag_idx, n_lmo) bind(c)
   use iso_c_binding, only: c_int, c_ptr, c_size_t
@@ -135,7 +135,7 @@ efp_compute_ai_disp(struct efp *efp)
 	}
 
 	efp_balance_work(efp, compute_ai_disp_range, NULL);
-	efp_allreduce(&efp->energy.ai_dispersion, 1);
+	efp_allreduce(efp, &efp->energy.ai_dispersion, 1);
 
 	return EFP_RESULT_SUCCESS;
 }
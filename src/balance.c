@@ -24,6 +24,10 @@
  * SUCH DAMAGE.
  */
 
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
 #ifdef EFP_USE_MPI
 #include <mpi.h>
 #endif
@@ -35,119 +39,637 @@
 #include "balance.h"
 #include "private.h"
 
+/* number of terms in fragment pair cost model */
+#define N_COST 6
+
+/* Pair cost is modeled as sum over terms of a[k](i) * b[k](j) where a and b
+ * depend only on sizes of fragments i and j. */
+static void
+get_cost_factors(const struct efp *efp, const struct frag *frag,
+    double *a, double *b)
+{
+	unsigned terms = efp->opts.terms;
+	double wf = (double)frag->xr_wf_size;
+	double lmo = (double)frag->n_lmo;
+	double mult = (double)(frag->n_atoms + frag->n_multipole_pts);
+	double pol = (double)frag->n_polarizable_pts;
+	double dpol = (double)frag->n_dynamic_polarizable_pts;
+
+	for (size_t k = 0; k < N_COST; k++)
+		a[k] = b[k] = 0.0;
+
+	/* overlap integrals and their transformation to LMO basis */
+	if (terms & EFP_TERM_XR) {
+		a[0] = wf;
+		b[0] = wf * lmo;
+		a[1] = wf * lmo;
+		b[1] = wf;
+	}
+	if (terms & EFP_TERM_ELEC) {
+		a[2] = mult;
+		b[2] = mult;
+	}
+	if (terms & EFP_TERM_DISP) {
+		a[3] = dpol;
+		b[3] = dpol;
+	}
+	if (terms & EFP_TERM_POL) {
+		a[4] = pol;
+		b[4] = mult + pol;
+		a[5] = mult + pol;
+		b[5] = pol;
+	}
+}
+
+void
+efp_update_cost(struct efp *efp)
+{
+	double a[N_COST], b[N_COST], sum[N_COST] = { 0 };
+	int use_nblist = efp->opts.enable_cutoff && !efp->nb_stale;
+
+	/* costs from timings are more accurate than the model */
+	if (efp->cost_measured)
+		return;
+
+	if (!use_nblist) {
+		for (size_t i = 0; i < efp->n_frag; i++) {
+			get_cost_factors(efp, efp->frags + i, a, b);
+
+			for (size_t k = 0; k < N_COST; k++)
+				sum[k] += b[k];
+		}
+	}
+
+	/* each pair is owned by one of the fragments so half of the pair
+	 * cost goes to every fragment */
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		double cost = 1.0;
+
+		get_cost_factors(efp, efp->frags + i, a, b);
+
+		if (use_nblist) {
+			size_t n_nb = efp_get_nb_count(efp, i);
+
+			for (size_t nb = 0; nb < n_nb; nb++) {
+				size_t j = efp_get_nb(efp, i, nb);
+				double aj[N_COST], bj[N_COST];
+
+				get_cost_factors(efp, efp->frags + j, aj, bj);
+
+				for (size_t k = 0; k < N_COST; k++)
+					cost += 0.5 * a[k] * bj[k];
+			}
+		} else {
+			for (size_t k = 0; k < N_COST; k++)
+				cost += 0.5 * a[k] * (sum[k] - b[k]);
+		}
+		efp->frag_cost[i] = cost;
+	}
+}
+
+void
+efp_refine_cost(struct efp *efp)
+{
+	double total = 0.0;
+
+	/* every fragment is timed only on the process which computed it;
+	 * the reduction leaves identical costs on all processes */
+	efp_allreduce(efp, efp->frag_time, efp->n_frag);
+
+	for (size_t i = 0; i < efp->n_frag; i++)
+		total += efp->frag_time[i];
+
+	if (total == 0.0)
+		return;
+
+	/* fragments without pairs still cost something to schedule */
+	for (size_t i = 0; i < efp->n_frag; i++)
+		efp->frag_cost[i] = efp->frag_time[i] +
+		    1.0e-3 * total / efp->n_frag;
+
+	efp->cost_measured = 1;
+}
+
+double
+efp_wtime(void)
+{
+#if defined(EFP_USE_MPI)
+	return MPI_Wtime();
+#elif defined(_OPENMP)
+	return omp_get_wtime();
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
 #ifdef EFP_USE_MPI
-struct master {
-	int total, range[2];
-};
+/* Fragments are split into contiguous blocks of equal estimated cost, one
+ * block per process. Every process computes the same boundaries so no
+ * communication is needed. */
+static void
+get_block(const struct efp *efp, int rank, int size, size_t *from,
+    size_t *to)
+{
+	double total = 0.0, sum = 0.0;
+	size_t i = 0;
+
+	for (size_t k = 0; k < efp->n_frag; k++)
+		total += efp->frag_cost[k];
 
-#define MPI_CHUNK_SIZE 16
+	while (i < efp->n_frag && sum < total * rank / size)
+		sum += efp->frag_cost[i++];
+
+	*from = i;
+
+	while (i < efp->n_frag && sum < total * (rank + 1) / size)
+		sum += efp->frag_cost[i++];
+
+	*to = rank == size - 1 ? efp->n_frag : i;
+}
+
+/* number of chunks each block is split into when stealing is enabled */
+#define STEAL_CHUNKS 8
 
 static int
-master_get_work(struct master *master, int range[2])
+claim_chunk(MPI_Win win, int target, size_t from, size_t to, size_t range[2])
 {
-#ifdef _OPENMP
-#pragma omp critical
-#endif
-	{
-		master->range[0] = master->range[1];
-		master->range[1] += MPI_CHUNK_SIZE;
+	long chunk = (long)((to - from) / STEAL_CHUNKS);
+	long next;
 
-		if (master->range[1] > master->total)
-			master->range[1] = master->total;
+	if (chunk < 1)
+		chunk = 1;
 
-		range[0] = master->range[0];
-		range[1] = master->range[1];
-	}
-	return range[1] > range[0];
+	MPI_Fetch_and_op(&chunk, &next, MPI_LONG, target, 0, MPI_SUM, win);
+	MPI_Win_flush(target, win);
+
+	if (next >= (long)to)
+		return 0;
+
+	range[0] = (size_t)next;
+	range[1] = (size_t)next + (size_t)chunk;
+
+	if (range[1] > to)
+		range[1] = to;
+
+	return 1;
 }
 
+/* Every process exposes a counter of the next unclaimed fragment in its
+ * block. Processes first work through their own blocks and then claim
+ * chunks from blocks of other processes. */
 static void
-master_on_master(struct master *master)
+steal_work(struct efp *efp, work_fn fn, void *data, int rank, int size)
 {
-	MPI_Status status;
-	int size, range[2];
+	size_t from, to, range[2];
+	long next, prev;
 
-	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	if (efp->steal_win == MPI_WIN_NULL) {
+		long *base;
 
-	while (master_get_work(master, range)) {
-		MPI_Recv(NULL, 0, MPI_INT, MPI_ANY_SOURCE, 0,
-		    MPI_COMM_WORLD, &status);
-		MPI_Send(range, 2, MPI_INT, status.MPI_SOURCE, 0,
-		    MPI_COMM_WORLD);
+		MPI_Win_allocate(sizeof(long), sizeof(long), MPI_INFO_NULL,
+		    efp->mpi_comm, &base, &efp->steal_win);
 	}
 
-	range[0] = range[1] = -1;
+	get_block(efp, rank, size, &from, &to);
+	next = (long)from;
+
+	MPI_Win_lock_all(0, efp->steal_win);
+	MPI_Fetch_and_op(&next, &prev, MPI_LONG, rank, 0, MPI_REPLACE,
+	    efp->steal_win);
+	MPI_Win_flush(rank, efp->steal_win);
+	MPI_Barrier(efp->mpi_comm);
+
+	for (int i = 0; i < size; i++) {
+		int target = (rank + i) % size;
 
-	for (int i = 1; i < size; i++) {
-		MPI_Recv(NULL, 0, MPI_INT, MPI_ANY_SOURCE, 0,
-		    MPI_COMM_WORLD, &status);
-		MPI_Send(range, 2, MPI_INT, status.MPI_SOURCE, 0,
-		    MPI_COMM_WORLD);
+		get_block(efp, target, size, &from, &to);
+
+		while (claim_chunk(efp->steal_win, target, from, to, range))
+			fn(efp, range[0], range[1], data);
 	}
+
+	MPI_Win_unlock_all(efp->steal_win);
+	MPI_Barrier(efp->mpi_comm);
 }
+#endif /* EFP_USE_MPI */
 
-static void
-slave_on_master(struct master *master, struct efp *efp, work_fn fn, void *data)
+#ifdef EFP_USE_MPI
+/* tag of halo exchange messages */
+#define HALO_TAG 1000
+
+struct rcb_item {
+	vec_t xyz;
+	double weight;
+	size_t frag;
+};
+
+static int
+cmp_rcb_x(const void *a, const void *b)
 {
-	int range[2];
+	double x = ((const struct rcb_item *)a)->xyz.x;
+	double y = ((const struct rcb_item *)b)->xyz.x;
 
-	while (master_get_work(master, range))
-		fn(efp, range[0], range[1], data);
+	return x < y ? -1 : x > y;
 }
 
-#ifndef _OPENMP
 static int
-omp_get_thread_num(void)
+cmp_rcb_y(const void *a, const void *b)
 {
-	return 0;
+	double x = ((const struct rcb_item *)a)->xyz.y;
+	double y = ((const struct rcb_item *)b)->xyz.y;
+
+	return x < y ? -1 : x > y;
 }
-#endif /* _OPENMP */
 
+static int
+cmp_rcb_z(const void *a, const void *b)
+{
+	double x = ((const struct rcb_item *)a)->xyz.z;
+	double y = ((const struct rcb_item *)b)->xyz.z;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Recursive coordinate bisection: fragments are sorted along the longest
+ * side of their bounding box and split so that both halves get weight
+ * proportional to the number of processes they are assigned to. */
 static void
-do_master(struct efp *efp, work_fn fn, void *data)
+split_rcb(struct efp *efp, struct rcb_item *items, size_t n, int rank_from,
+    int rank_to)
 {
-	struct master master;
+	vec_t lo, hi;
+	double total = 0.0, sum = 0.0, target;
+	int mid = (rank_from + rank_to) / 2;
+	size_t k = 0;
 
-	master.total = (int)efp->n_frag;
-	master.range[0] = master.range[1] = 0;
+	if (rank_to - rank_from == 1) {
+		for (size_t i = 0; i < n; i++)
+			efp->frag_owner[items[i].frag] = rank_from;
+		return;
+	}
+	if (n == 0)
+		return;
 
-#ifdef _OPENMP
-#pragma omp parallel
-#endif
-	{
-		if (omp_get_thread_num() == 0)
-			master_on_master(&master);
-		else
-			slave_on_master(&master, efp, fn, data);
+	lo = hi = items[0].xyz;
+
+	for (size_t i = 0; i < n; i++) {
+		lo.x = items[i].xyz.x < lo.x ? items[i].xyz.x : lo.x;
+		lo.y = items[i].xyz.y < lo.y ? items[i].xyz.y : lo.y;
+		lo.z = items[i].xyz.z < lo.z ? items[i].xyz.z : lo.z;
+		hi.x = items[i].xyz.x > hi.x ? items[i].xyz.x : hi.x;
+		hi.y = items[i].xyz.y > hi.y ? items[i].xyz.y : hi.y;
+		hi.z = items[i].xyz.z > hi.z ? items[i].xyz.z : hi.z;
+		total += items[i].weight;
 	}
+
+	if (hi.x - lo.x >= hi.y - lo.y && hi.x - lo.x >= hi.z - lo.z)
+		qsort(items, n, sizeof(struct rcb_item), cmp_rcb_x);
+	else if (hi.y - lo.y >= hi.z - lo.z)
+		qsort(items, n, sizeof(struct rcb_item), cmp_rcb_y);
+	else
+		qsort(items, n, sizeof(struct rcb_item), cmp_rcb_z);
+
+	target = total * (mid - rank_from) / (rank_to - rank_from);
+
+	while (k < n && sum < target)
+		sum += items[k++].weight;
+
+	split_rcb(efp, items, k, rank_from, mid);
+	split_rcb(efp, items + k, n - k, mid, rank_to);
 }
 
-static void
-do_slave(struct efp *efp, work_fn fn, void *data)
+/* Every process computes the same partition from fragment coordinates so no
+ * communication is needed. Weight of a fragment is the number of its
+ * polarizable points times the number of its neighbors. */
+static enum efp_result
+partition_frags(struct efp *efp, int rank, int size)
 {
-	int range[2];
+	struct rcb_item *items;
+
+	items = (struct rcb_item *)malloc(efp->n_frag *
+	    sizeof(struct rcb_item));
+	if (items == NULL)
+		return EFP_RESULT_NO_MEMORY;
 
-	for (;;) {
-		MPI_Send(NULL, 0, MPI_INT, 0, 0, MPI_COMM_WORLD);
-		MPI_Recv(range, 2, MPI_INT, 0, 0, MPI_COMM_WORLD,
-		    MPI_STATUS_IGNORE);
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		const struct frag *frag = efp->frags + i;
+		vec_t xyz = { frag->x, frag->y, frag->z };
 
-		if (range[0] == -1 ||
-		    range[1] == -1)
-			break;
+		if (efp->opts.enable_pbc) {
+			xyz.x -= efp->box.x * floor(xyz.x / efp->box.x);
+			xyz.y -= efp->box.y * floor(xyz.y / efp->box.y);
+			xyz.z -= efp->box.z * floor(xyz.z / efp->box.z);
+		}
 
-		fn(efp, range[0], range[1], data);
+		items[i].xyz = xyz;
+		items[i].weight = (double)frag->n_polarizable_pts *
+		    (double)(efp_get_nb_count(efp, i) + 1);
+		items[i].frag = i;
 	}
+
+	split_rcb(efp, items, efp->n_frag, 0, size);
+	free(items);
+
+	efp->n_own_frags = 0;
+
+	for (size_t i = 0; i < efp->n_frag; i++)
+		if (efp->frag_owner[i] == rank)
+			efp->own_frags[efp->n_own_frags++] = i;
+
+	return EFP_RESULT_SUCCESS;
+}
+
+struct halo_item {
+	int peer;
+	size_t frag;
+};
+
+static int
+cmp_halo_item(const void *a, const void *b)
+{
+	const struct halo_item *x = (const struct halo_item *)a;
+	const struct halo_item *y = (const struct halo_item *)b;
+
+	if (x->peer != y->peer)
+		return x->peer < y->peer ? -1 : 1;
+
+	return x->frag < y->frag ? -1 : x->frag > y->frag;
+}
+
+/* Owned fragment i is sent to every process which owns a neighbor of i.
+ * Neighbor lists are symmetric, so fragment j of another process is received
+ * if it has an owned neighbor. Fragments without polarizable points are
+ * never exchanged. Both lists are sorted by peer and fragment index, so that
+ * matching lists on both sides of a message have the same order. */
+static size_t
+get_halo_items(const struct efp *efp, int rank, int *mark, int send,
+    struct halo_item *items)
+{
+	size_t n = 0;
+
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		size_t n_nb = efp_get_nb_count(efp, i);
+
+		if (efp->frags[i].n_polarizable_pts == 0)
+			continue;
+		if ((efp->frag_owner[i] == rank) != send)
+			continue;
+
+		for (size_t k = 0; k < n_nb; k++) {
+			size_t j = efp_get_nb(efp, i, k);
+			int peer = efp->frag_owner[j];
+
+			if (efp->frags[j].n_polarizable_pts == 0)
+				continue;
+			if (send && (peer == rank || mark[peer] == (int)i + 1))
+				continue;
+			if (!send && peer != rank)
+				continue;
+
+			if (items) {
+				items[n].peer = send ? peer :
+				    efp->frag_owner[i];
+				items[n].frag = i;
+			}
+			n++;
+
+			if (!send)
+				break;
+
+			mark[peer] = (int)i + 1;
+		}
+	}
+	return n;
+}
+
+static size_t
+get_halo_size(const struct efp *efp, const size_t *frags, size_t n)
+{
+	size_t size = 0;
+
+	for (size_t i = 0; i < n; i++)
+		size += efp->frags[frags[i]].n_polarizable_pts;
+
+	return 6 * size;
+}
+
+static enum efp_result
+build_halo(struct efp *efp, int rank, int size)
+{
+	struct halo *halo = &efp->halo;
+	struct halo_item *send = NULL, *recv = NULL;
+	size_t n_send, n_recv;
+	int *mark;
+	enum efp_result res = EFP_RESULT_NO_MEMORY;
+
+	efp_free_halo(efp);
+
+	if ((mark = (int *)malloc((size_t)size * sizeof(int))) == NULL)
+		return EFP_RESULT_NO_MEMORY;
+
+	for (int i = 0; i < size; i++)
+		mark[i] = 0;
+
+	n_send = get_halo_items(efp, rank, mark, 1, NULL);
+	n_recv = get_halo_items(efp, rank, mark, 0, NULL);
+
+	for (int i = 0; i < size; i++)
+		mark[i] = 0;
+
+	send = (struct halo_item *)malloc((n_send + 1) *
+	    sizeof(struct halo_item));
+	recv = (struct halo_item *)malloc((n_recv + 1) *
+	    sizeof(struct halo_item));
+	halo->peers = (int *)malloc((n_send + 1) * sizeof(int));
+	halo->send_offset = (size_t *)malloc((n_send + 1) * sizeof(size_t));
+	halo->recv_offset = (size_t *)malloc((n_send + 1) * sizeof(size_t));
+	halo->send_frags = (size_t *)malloc((n_send + 1) * sizeof(size_t));
+	halo->recv_frags = (size_t *)malloc((n_recv + 1) * sizeof(size_t));
+
+	if (!send || !recv || !halo->peers || !halo->send_offset ||
+	    !halo->recv_offset || !halo->send_frags || !halo->recv_frags)
+		goto error;
+
+	get_halo_items(efp, rank, mark, 1, send);
+	get_halo_items(efp, rank, mark, 0, recv);
+
+	qsort(send, n_send, sizeof(struct halo_item), cmp_halo_item);
+	qsort(recv, n_recv, sizeof(struct halo_item), cmp_halo_item);
+
+	halo->n_peers = 0;
+
+	for (size_t i = 0, j = 0; i < n_send; i++) {
+		if (i == 0 || send[i].peer != send[i - 1].peer) {
+			halo->peers[halo->n_peers] = send[i].peer;
+			halo->send_offset[halo->n_peers] = i;
+			halo->recv_offset[halo->n_peers] = j;
+			halo->n_peers++;
+
+			while (j < n_recv && recv[j].peer == send[i].peer)
+				j++;
+		}
+		halo->send_frags[i] = send[i].frag;
+	}
+	halo->send_offset[halo->n_peers] = n_send;
+	halo->recv_offset[halo->n_peers] = n_recv;
+
+	for (size_t j = 0; j < n_recv; j++)
+		halo->recv_frags[j] = recv[j].frag;
+
+	halo->send_buf = (double *)malloc((get_halo_size(efp,
+	    halo->send_frags, n_send) + 1) * sizeof(double));
+	halo->recv_buf = (double *)malloc((get_halo_size(efp,
+	    halo->recv_frags, n_recv) + 1) * sizeof(double));
+
+	if (!halo->send_buf || !halo->recv_buf)
+		goto error;
+
+	res = EFP_RESULT_SUCCESS;
+error:
+	free(mark);
+	free(send);
+	free(recv);
+	return res;
 }
 #endif /* EFP_USE_MPI */
 
+/* With MPI and interaction cutoff, iterative polarization solver is run in
+ * distributed mode. Each process owns a spatial subset of fragments and
+ * updates induced dipoles only on their polarizable points. Induced dipoles
+ * of neighbors owned by other processes are exchanged with peer processes
+ * after each iteration. */
+enum efp_result
+efp_setup_halo(struct efp *efp)
+{
+	/* partition is kept until neighbor lists are rebuilt */
+	if (!efp->halo_stale)
+		return EFP_RESULT_SUCCESS;
+
+	efp->dist_pol = 0;
+
+#ifdef EFP_USE_MPI
+	enum efp_result res;
+	int rank, size;
+
+	MPI_Comm_rank(efp->mpi_comm, &rank);
+	MPI_Comm_size(efp->mpi_comm, &size);
+
+	if (size > 1 && efp->opts.enable_cutoff &&
+	    efp->opts.pol_driver == EFP_POL_DRIVER_ITERATIVE) {
+		if ((res = partition_frags(efp, rank, size)))
+			return res;
+		if ((res = build_halo(efp, rank, size)))
+			return res;
+
+		efp->halo.rank = rank;
+		efp->dist_pol = 1;
+	}
+#endif
+	efp->halo_stale = 0;
+	return EFP_RESULT_SUCCESS;
+}
+
+/* sends induced and conjugate induced dipoles of owned points to peers and
+ * receives those of their neighbors */
+void
+efp_exchange_halo(struct efp *efp, double *id, double *id_conj)
+{
+#ifdef EFP_USE_MPI
+	struct halo *halo = &efp->halo;
+	MPI_Request *req;
+	double *buf;
+
+	if (!efp->dist_pol || halo->n_peers == 0)
+		return;
+
+	req = (MPI_Request *)malloc(2 * halo->n_peers * sizeof(MPI_Request));
+	assert(req);
+
+	buf = halo->recv_buf;
+
+	for (size_t k = 0; k < halo->n_peers; k++) {
+		size_t from = halo->recv_offset[k];
+		size_t to = halo->recv_offset[k + 1];
+		size_t n = get_halo_size(efp, halo->recv_frags + from,
+		    to - from);
+
+		MPI_Irecv(buf, (int)n, MPI_DOUBLE, halo->peers[k], HALO_TAG,
+		    efp->mpi_comm, req + k);
+		buf += n;
+	}
+
+	buf = halo->send_buf;
+
+	for (size_t k = 0; k < halo->n_peers; k++) {
+		double *start = buf;
+
+		for (size_t f = halo->send_offset[k];
+		    f < halo->send_offset[k + 1]; f++) {
+			const struct frag *frag = efp->frags +
+			    halo->send_frags[f];
+
+			for (size_t p = 0; p < frag->n_polarizable_pts; p++) {
+				size_t idx = frag->polarizable_offset + p;
+
+				memcpy(buf, id + 3 * idx, 3 * sizeof(double));
+				memcpy(buf + 3, id_conj + 3 * idx,
+				    3 * sizeof(double));
+				buf += 6;
+			}
+		}
+		MPI_Isend(start, (int)(buf - start), MPI_DOUBLE,
+		    halo->peers[k], HALO_TAG, efp->mpi_comm,
+		    req + halo->n_peers + k);
+	}
+
+	MPI_Waitall((int)(2 * halo->n_peers), req, MPI_STATUSES_IGNORE);
+	free(req);
+
+	buf = halo->recv_buf;
+
+	for (size_t f = 0; f < halo->recv_offset[halo->n_peers]; f++) {
+		const struct frag *frag = efp->frags + halo->recv_frags[f];
+
+		for (size_t p = 0; p < frag->n_polarizable_pts; p++) {
+			size_t idx = frag->polarizable_offset + p;
+
+			memcpy(id + 3 * idx, buf, 3 * sizeof(double));
+			memcpy(id_conj + 3 * idx, buf + 3,
+			    3 * sizeof(double));
+			buf += 6;
+		}
+	}
+#else
+	(void)efp;
+	(void)id;
+	(void)id_conj;
+#endif
+}
+
 void
-efp_allreduce(double *x, size_t n)
+efp_free_halo(struct efp *efp)
+{
+	struct halo *halo = &efp->halo;
+
+	free(halo->peers);
+	free(halo->send_offset);
+	free(halo->send_frags);
+	free(halo->recv_offset);
+	free(halo->recv_frags);
+	free(halo->send_buf);
+	free(halo->recv_buf);
+
+	memset(halo, 0, sizeof(*halo));
+}
+
+void
+efp_allreduce(struct efp *efp, double *x, size_t n)
 {
 #ifdef EFP_USE_MPI
 	MPI_Allreduce(MPI_IN_PLACE, x, (int)n, MPI_DOUBLE,
-	    MPI_SUM, MPI_COMM_WORLD);
+	    MPI_SUM, efp->mpi_comm);
 #else
+	(void)efp;
 	(void)x;
 	(void)n;
 #endif
@@ -158,21 +680,18 @@ efp_balance_work(struct efp *efp, work_fn fn, void *data)
 {
 #ifdef EFP_USE_MPI
 	int rank, size;
+	size_t from, to;
 
-	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	MPI_Comm_rank(efp->mpi_comm, &rank);
+	MPI_Comm_size(efp->mpi_comm, &size);
 
 	if (size == 1)
 		fn(efp, 0, efp->n_frag, data);
+	else if (efp->opts.enable_work_stealing)
+		steal_work(efp, fn, data, rank, size);
 	else {
-		MPI_Barrier(MPI_COMM_WORLD);
-
-		if (rank == 0)
-			do_master(efp, fn, data);
-		else
-			do_slave(efp, fn, data);
-
-		MPI_Barrier(MPI_COMM_WORLD);
+		get_block(efp, rank, size, &from, &to);
+		fn(efp, from, to, data);
 	}
 #else
 	fn(efp, 0, efp->n_frag, data);
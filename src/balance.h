@@ -29,11 +29,19 @@
 
 #include <stddef.h>
 
+#include "efp.h"
+
 struct efp;
 
 typedef void (*work_fn)(struct efp *, size_t, size_t, void *);
 
-void efp_allreduce(double *, size_t);
+void efp_allreduce(struct efp *, double *, size_t);
+enum efp_result efp_setup_halo(struct efp *);
+void efp_exchange_halo(struct efp *, double *, double *);
+void efp_free_halo(struct efp *);
 void efp_balance_work(struct efp *, work_fn, void *);
+void efp_update_cost(struct efp *);
+void efp_refine_cost(struct efp *);
+double efp_wtime(void);
 
 #endif /* LIBEFP_BALANCE_H */
@@ -52,14 +52,58 @@ void dsyev_(char *,
 	    fortranint_t *,
 	    fortranint_t *);
 
-void dgesv_(fortranint_t *,
-	    fortranint_t *,
-	    double *,
-	    fortranint_t *,
-	    fortranint_t *,
-	    double *,
-	    fortranint_t *,
-	    fortranint_t *);
+void dgetrf_(fortranint_t *,
+	     fortranint_t *,
+	     double *,
+	     fortranint_t *,
+	     fortranint_t *,
+	     fortranint_t *);
+
+void dgetrs_(char *,
+	     fortranint_t *,
+	     fortranint_t *,
+	     double *,
+	     fortranint_t *,
+	     fortranint_t *,
+	     double *,
+	     fortranint_t *,
+	     fortranint_t *);
+
+void dgbtrf_(fortranint_t *,
+	     fortranint_t *,
+	     fortranint_t *,
+	     fortranint_t *,
+	     double *,
+	     fortranint_t *,
+	     fortranint_t *,
+	     fortranint_t *);
+
+void dgbtrs_(char *,
+	     fortranint_t *,
+	     fortranint_t *,
+	     fortranint_t *,
+	     fortranint_t *,
+	     double *,
+	     fortranint_t *,
+	     fortranint_t *,
+	     double *,
+	     fortranint_t *,
+	     fortranint_t *);
+
+void dsptrf_(char *,
+	     fortranint_t *,
+	     double *,
+	     fortranint_t *,
+	     fortranint_t *);
+
+void dsptrs_(char *,
+	     fortranint_t *,
+	     fortranint_t *,
+	     double *,
+	     fortranint_t *,
+	     double *,
+	     fortranint_t *,
+	     fortranint_t *);
 
 void
 efp_dgemm(char transa, char transb, fortranint_t m, fortranint_t n,
@@ -87,12 +131,67 @@ efp_dsyev(char jobz, char uplo, fortranint_t n, double *a, fortranint_t lda,
 }
 
 fortranint_t
-efp_dgesv(fortranint_t n, fortranint_t nrhs, double *a, fortranint_t lda,
+efp_dgetrf(fortranint_t m, fortranint_t n, double *a, fortranint_t lda,
+    fortranint_t *ipiv)
+{
+	fortranint_t info;
+
+	dgetrf_(&m, &n, a, &lda, ipiv, &info);
+
+	return info;
+}
+
+fortranint_t
+efp_dgetrs(char trans, fortranint_t n, fortranint_t nrhs, double *a,
+    fortranint_t lda, fortranint_t *ipiv, double *b, fortranint_t ldb)
+{
+	fortranint_t info;
+
+	dgetrs_(&trans, &n, &nrhs, a, &lda, ipiv, b, &ldb, &info);
+
+	return info;
+}
+
+fortranint_t
+efp_dgbtrf(fortranint_t m, fortranint_t n, fortranint_t kl, fortranint_t ku,
+    double *ab, fortranint_t ldab, fortranint_t *ipiv)
+{
+	fortranint_t info;
+
+	dgbtrf_(&m, &n, &kl, &ku, ab, &ldab, ipiv, &info);
+
+	return info;
+}
+
+fortranint_t
+efp_dgbtrs(char trans, fortranint_t n, fortranint_t kl, fortranint_t ku,
+    fortranint_t nrhs, double *ab, fortranint_t ldab, fortranint_t *ipiv,
+    double *b, fortranint_t ldb)
+{
+	fortranint_t info;
+
+	dgbtrs_(&trans, &n, &kl, &ku, &nrhs, ab, &ldab, ipiv, b, &ldb, &info);
+
+	return info;
+}
+
+fortranint_t
+efp_dsptrf(char uplo, fortranint_t n, double *ap, fortranint_t *ipiv)
+{
+	fortranint_t info;
+
+	dsptrf_(&uplo, &n, ap, ipiv, &info);
+
+	return info;
+}
+
+fortranint_t
+efp_dsptrs(char uplo, fortranint_t n, fortranint_t nrhs, double *ap,
     fortranint_t *ipiv, double *b, fortranint_t ldb)
 {
 	fortranint_t info;
 
-	dgesv_(&n, &nrhs, a, &lda, ipiv, b, &ldb, &info);
+	dsptrs_(&uplo, &n, &nrhs, ap, ipiv, b, &ldb, &info);
 
 	return info;
 }
@@ -24,6 +24,8 @@
  * SUCH DAMAGE.
  */
 
+#include <stdlib.h>
+
 #include "private.h"
 
 static const double weights[] = {
@@ -89,6 +91,7 @@ disp_tt(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx, size_t pt_i_idx,
 	double energy = -4.0 / 3.0 * sum * damp / r6;
 
 	if (efp->do_gradient) {
+		struct workspace *ws = efp_get_workspace(efp);
 		double gdamp = get_damp_tt_grad(r);
 		double g = 4.0 / 3.0 * sum * (gdamp / r - 6.0 * damp / r2) / r6;
 
@@ -98,11 +101,11 @@ disp_tt(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx, size_t pt_i_idx,
 			g * dr.z * swf->swf
 		};
 
-		efp_add_force(efp->grad + fr_i_idx, CVEC(fr_i->x),
+		efp_add_force(ws->grad + fr_i_idx, CVEC(fr_i->x),
 		    CVEC(pt_i->x), &force, NULL);
-		efp_sub_force(efp->grad + fr_j_idx, CVEC(fr_j->x),
+		efp_sub_force(ws->grad + fr_j_idx, CVEC(fr_j->x),
 		    CVEC(pt_j->x), &force, NULL);
-		efp_add_stress(&swf->dr, &force, &efp->stress);
+		efp_add_stress(&swf->dr, &force, ws->stress);
 	}
 	return energy;
 }
@@ -142,6 +145,7 @@ disp_overlap(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
 	double energy = -4.0 / 3.0 * sum * damp / r6;
 
 	if (efp->do_gradient) {
+		struct workspace *ws = efp_get_workspace(efp);
 		vec_t force, torque_i, torque_j;
 
 		double t1 = -8.0 * sum / r6 / r2 * damp;
@@ -171,11 +175,11 @@ disp_overlap(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
 		    t2 * (ds_ij.y * swf->dr.x - ds_ij.x * swf->dr.y) +
 		    t2 * ds_ij.c);
 
-		six_atomic_add_xyz(efp->grad + fr_i_idx, &force);
-		six_atomic_add_abc(efp->grad + fr_i_idx, &torque_i);
-		six_atomic_sub_xyz(efp->grad + fr_j_idx, &force);
-		six_atomic_sub_abc(efp->grad + fr_j_idx, &torque_j);
-		efp_add_stress(&swf->dr, &force, &efp->stress);
+		six_add_xyz(ws->grad + fr_i_idx, &force);
+		six_add_abc(ws->grad + fr_i_idx, &torque_i);
+		six_sub_xyz(ws->grad + fr_j_idx, &force);
+		six_sub_abc(ws->grad + fr_j_idx, &torque_j);
+		efp_add_stress(&swf->dr, &force, ws->stress);
 	}
 	return energy;
 }
@@ -205,6 +209,7 @@ disp_off(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx, size_t pt_i_idx,
 	double energy = -4.0 / 3.0 * sum / r6;
 
 	if (efp->do_gradient) {
+		struct workspace *ws = efp_get_workspace(efp);
 		double r8 = r6 * r2;
 		double g = -8.0 * sum / r8;
 
@@ -214,39 +219,20 @@ disp_off(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx, size_t pt_i_idx,
 			g * dr.z * swf->swf
 		};
 
-		efp_add_force(efp->grad + fr_i_idx, CVEC(fr_i->x),
+		efp_add_force(ws->grad + fr_i_idx, CVEC(fr_i->x),
 		    CVEC(pt_i->x), &force, NULL);
-		efp_sub_force(efp->grad + fr_j_idx, CVEC(fr_j->x),
+		efp_sub_force(ws->grad + fr_j_idx, CVEC(fr_j->x),
 		    CVEC(pt_j->x), &force, NULL);
-		efp_add_stress(&swf->dr, &force, &efp->stress);
+		efp_add_stress(&swf->dr, &force, ws->stress);
 	}
 	return energy;
 }
 
 static double
 point_point_disp(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
-    size_t pt_i_idx, size_t pt_j_idx, double s, six_t ds, const struct swf *swf)
+    size_t pt_i_idx, size_t pt_j_idx, double sum, double s, six_t ds,
+    const struct swf *swf)
 {
-	struct frag *fr_i = efp->frags + fr_i_idx;
-	struct frag *fr_j = efp->frags + fr_j_idx;
-
-	const struct dynamic_polarizable_pt *pt_i =
-	    fr_i->dynamic_polarizable_pts + pt_i_idx;
-	const struct dynamic_polarizable_pt *pt_j =
-	    fr_j->dynamic_polarizable_pts + pt_j_idx;
-
-	double sum = 0.0;
-
-	for (size_t k = 0; k < ARRAY_SIZE(weights); k++) {
-		double tr_i = (pt_i->tensor[k].xx +
-			       pt_i->tensor[k].yy +
-			       pt_i->tensor[k].zz) / 3;
-		double tr_j = (pt_j->tensor[k].xx +
-			       pt_j->tensor[k].yy +
-			       pt_j->tensor[k].zz) / 3;
-		sum += weights[k] * tr_i * tr_j;
-	}
-
 	switch (efp->opts.disp_damp) {
 	case EFP_DISP_DAMP_TT:
 		return disp_tt(efp, fr_i_idx, fr_j_idx,
@@ -273,7 +259,7 @@ point_point_disp(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
  */
 double
 efp_frag_frag_disp(struct efp *efp, size_t frag_i, size_t frag_j,
-    const double *s, const six_t *ds)
+    const struct swf *swf, const double *s, const six_t *ds)
 {
 	double energy = 0.0;
 
@@ -283,24 +269,88 @@ efp_frag_frag_disp(struct efp *efp, size_t frag_i, size_t frag_j,
 	size_t n_disp_i = fr_i->n_dynamic_polarizable_pts;
 	size_t n_disp_j = fr_j->n_dynamic_polarizable_pts;
 
-	struct swf swf = efp_make_swf(efp, fr_i, fr_j);
+	size_t c6_off = efp->disp_c6_offset[fr_i->lib_idx * efp->n_disp_lib +
+	    fr_j->lib_idx];
+	const double *c6 = efp->disp_c6 + c6_off;
 
 	for (size_t ii = 0, idx = 0; ii < n_disp_i; ii++)
 		for (size_t jj = 0; jj < n_disp_j; jj++, idx++)
 			energy += point_point_disp(efp, frag_i, frag_j, ii, jj,
-			    s[idx], ds[idx], &swf);
+			    c6[idx], s[idx], ds[idx], swf);
 
-	vec_t force = {
-		swf.dswf.x * energy,
-		swf.dswf.y * energy,
-		swf.dswf.z * energy
-	};
+	return energy;
+}
 
-	six_atomic_add_xyz(efp->grad + frag_i, &force);
-	six_atomic_sub_xyz(efp->grad + frag_j, &force);
-	efp_add_stress(&swf.dr, &force, &efp->stress);
+static double
+get_iso_dynamic_pol(const struct dynamic_polarizable_pt *pt, size_t k)
+{
+	return (pt->tensor[k].xx + pt->tensor[k].yy + pt->tensor[k].zz) / 3;
+}
 
-	return energy * swf.swf;
+static void
+setup_c6_table(const struct frag *fr_i, const struct frag *fr_j, double *c6)
+{
+	for (size_t ii = 0; ii < fr_i->n_dynamic_polarizable_pts; ii++) {
+		const struct dynamic_polarizable_pt *pt_i =
+		    fr_i->dynamic_polarizable_pts + ii;
+
+		for (size_t jj = 0; jj < fr_j->n_dynamic_polarizable_pts;
+		    jj++) {
+			const struct dynamic_polarizable_pt *pt_j =
+			    fr_j->dynamic_polarizable_pts + jj;
+			double sum = 0.0;
+
+			for (size_t k = 0; k < ARRAY_SIZE(weights); k++)
+				sum += weights[k] *
+				    get_iso_dynamic_pol(pt_i, k) *
+				    get_iso_dynamic_pol(pt_j, k);
+
+			*c6++ = sum;
+		}
+	}
+}
+
+/* Point-point dispersion depends on geometry only through distance and
+ * damping. Frequency sums for all pairs of points are computed once from
+ * library fragments, as traces of polarizability tensors do not change with
+ * rotation. */
+enum efp_result
+efp_setup_disp(struct efp *efp)
+{
+	size_t n_lib = efp->n_lib, size = 0;
+
+	free(efp->disp_c6_offset);
+	free(efp->disp_c6);
+
+	efp->n_disp_lib = n_lib;
+	efp->disp_c6 = NULL;
+	efp->disp_c6_offset = (size_t *)malloc((n_lib * n_lib + 1) *
+	    sizeof(size_t));
+	if (efp->disp_c6_offset == NULL)
+		return EFP_RESULT_NO_MEMORY;
+
+	for (size_t a = 0; a < n_lib; a++) {
+		for (size_t b = 0; b < n_lib; b++) {
+			efp->disp_c6_offset[a * n_lib + b] = size;
+			size += efp->lib[a]->n_dynamic_polarizable_pts *
+			    efp->lib[b]->n_dynamic_polarizable_pts;
+		}
+	}
+	efp->disp_c6_offset[n_lib * n_lib] = size;
+
+	if (size == 0)
+		return EFP_RESULT_SUCCESS;
+
+	efp->disp_c6 = (double *)malloc(size * sizeof(double));
+	if (efp->disp_c6 == NULL)
+		return EFP_RESULT_NO_MEMORY;
+
+	for (size_t a = 0; a < n_lib; a++)
+		for (size_t b = 0; b < n_lib; b++)
+			setup_c6_table(efp->lib[a], efp->lib[b], efp->disp_c6 +
+			    efp->disp_c6_offset[a * n_lib + b]);
+
+	return EFP_RESULT_SUCCESS;
 }
 
 void
@@ -314,6 +364,20 @@ efp_update_disp(struct frag *frag)
 
 		efp_move_pt(CVEC(frag->x), &frag->rotmat,
 		    CVEC(pt_in->x), VEC(pt_out->x));
+	}
+}
+
+/* rotated tensors are needed only for AI/EFP dispersion, fragment-fragment
+ * dispersion uses precomputed isotropic coefficients */
+void
+efp_update_disp_tensors(struct frag *frag)
+{
+	for (size_t i = 0; i < frag->n_dynamic_polarizable_pts; i++) {
+		const struct dynamic_polarizable_pt *pt_in =
+		    frag->lib->dynamic_polarizable_pts + i;
+		struct dynamic_polarizable_pt *pt_out =
+		    frag->dynamic_polarizable_pts + i;
+
 		for (size_t j = 0; j < 12; j++) {
 			const mat_t *in = pt_in->tensor + j;
 			mat_t *out = pt_out->tensor + j;
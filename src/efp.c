@@ -27,6 +27,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "balance.h"
 #include "clapack.h"
 #include "elec.h"
@@ -45,6 +49,8 @@ update_fragment(struct frag *frag)
 	efp_update_pol(frag);
 	efp_update_disp(frag);
 	efp_update_xr(frag);
+
+	frag->stale = FRAG_STALE_ALL;
 }
 
 static enum efp_result
@@ -55,7 +61,6 @@ set_coord_xyzabc(struct frag *frag, const double *coord)
 	frag->z = coord[2];
 
 	euler_to_matrix(coord[3], coord[4], coord[5], &frag->rotmat);
-	update_fragment(frag);
 
 	return EFP_RESULT_SUCCESS;
 }
@@ -96,8 +101,6 @@ set_coord_points(struct frag *frag, const double *coord)
 	frag->y = coord[1] - p1.y;
 	frag->z = coord[2] - p1.z;
 
-	update_fragment(frag);
-
 	return EFP_RESULT_SUCCESS;
 }
 
@@ -114,7 +117,6 @@ set_coord_rotmat(struct frag *frag, const double *coord)
 	frag->z = coord[2];
 
 	memcpy(&frag->rotmat, coord + 3, sizeof(frag->rotmat));
-	update_fragment(frag);
 
 	return EFP_RESULT_SUCCESS;
 }
@@ -150,6 +152,177 @@ free_frag(struct frag *frag)
 	/* don't do free(frag) here */
 }
 
+static void
+free_workspaces(struct efp *efp)
+{
+	for (size_t i = 0; i < efp->n_ws; i++) {
+		struct workspace *ws = efp->ws + i;
+
+		free(ws->lmo_s);
+		free(ws->lmo_ds);
+		free(ws->s);
+		free(ws->t);
+		free(ws->lmo_t);
+		free(ws->tmp);
+		free(ws->atoms_j);
+		free(ws->ds);
+		free(ws->dt);
+		free(ws->lmo_dt);
+		free(ws->sixtmp);
+		free(ws->lmo_tmp);
+		free(ws->grad);
+		free(ws->ptc_grad);
+		free(ws->stress);
+		free(ws->field);
+	}
+	free(efp->ws);
+
+	efp->ws = NULL;
+	efp->n_ws = 0;
+	efp->ws_grad = 0;
+}
+
+static enum efp_result
+alloc_workspace(const struct efp *efp, struct workspace *ws, size_t n_lmo,
+    size_t wf_size, size_t n_xr_atoms)
+{
+	size_t n_lmo2 = n_lmo * n_lmo;
+	size_t wf_size2 = wf_size * wf_size;
+	size_t n_lmo_wf = n_lmo * wf_size;
+
+	ws->lmo_s = (double *)malloc(n_lmo2 * sizeof(double));
+	ws->lmo_ds = (six_t *)malloc(n_lmo2 * sizeof(six_t));
+	ws->s = (double *)malloc(wf_size2 * sizeof(double));
+	ws->t = (double *)malloc(wf_size2 * sizeof(double));
+	ws->lmo_t = (double *)malloc(n_lmo2 * sizeof(double));
+	ws->tmp = (double *)malloc(n_lmo_wf * sizeof(double));
+	ws->atoms_j = (struct xr_atom *)malloc(n_xr_atoms *
+	    sizeof(struct xr_atom));
+
+	if (!ws->lmo_s || !ws->lmo_ds || !ws->s || !ws->t || !ws->lmo_t ||
+	    !ws->tmp || !ws->atoms_j)
+		return EFP_RESULT_NO_MEMORY;
+
+	if (efp->n_polarizable_pts > 0) {
+		ws->field = (vec_t *)calloc(efp->n_polarizable_pts,
+		    sizeof(vec_t));
+		if (!ws->field)
+			return EFP_RESULT_NO_MEMORY;
+	}
+
+	if (!efp->do_gradient)
+		return EFP_RESULT_SUCCESS;
+
+	ws->ds = (six_t *)malloc(wf_size2 * sizeof(six_t));
+	ws->dt = (six_t *)malloc(wf_size2 * sizeof(six_t));
+	ws->lmo_dt = (six_t *)malloc(n_lmo2 * sizeof(six_t));
+	ws->sixtmp = (six_t *)malloc(n_lmo_wf * sizeof(six_t));
+	ws->lmo_tmp = (double *)malloc(n_lmo2 * sizeof(double));
+
+	if (!ws->ds || !ws->dt || !ws->lmo_dt || !ws->sixtmp || !ws->lmo_tmp)
+		return EFP_RESULT_NO_MEMORY;
+
+	ws->grad = (six_t *)calloc(efp->n_frag, sizeof(six_t));
+	if (!ws->grad)
+		return EFP_RESULT_NO_MEMORY;
+
+	if (efp->n_ptc > 0) {
+		ws->ptc_grad = (vec_t *)calloc(efp->n_ptc, sizeof(vec_t));
+		if (!ws->ptc_grad)
+			return EFP_RESULT_NO_MEMORY;
+	}
+
+	if (!efp->opts.disable_stress) {
+		ws->stress = (mat_t *)calloc(1, sizeof(mat_t));
+		if (!ws->stress)
+			return EFP_RESULT_NO_MEMORY;
+	}
+
+	return EFP_RESULT_SUCCESS;
+}
+
+/* resize gradient buffers which depend on the number of point charges
+ * and stress options without touching the rest of the workspaces */
+static enum efp_result
+resize_workspace_grad(struct efp *efp, size_t n_ptc, int disable_stress)
+{
+	if (!efp->ws_grad)
+		return EFP_RESULT_SUCCESS;
+
+	for (size_t i = 0; i < efp->n_ws; i++) {
+		struct workspace *ws = efp->ws + i;
+
+		free(ws->ptc_grad);
+		free(ws->stress);
+		ws->ptc_grad = NULL;
+		ws->stress = NULL;
+
+		if (n_ptc > 0) {
+			ws->ptc_grad = (vec_t *)calloc(n_ptc, sizeof(vec_t));
+			if (!ws->ptc_grad)
+				goto fail;
+		}
+		if (!disable_stress) {
+			ws->stress = (mat_t *)calloc(1, sizeof(mat_t));
+			if (!ws->stress)
+				goto fail;
+		}
+	}
+	return EFP_RESULT_SUCCESS;
+fail:
+	/* next gradient computation reallocates all workspaces */
+	efp->ws_grad = 0;
+	return EFP_RESULT_NO_MEMORY;
+}
+
+/* one workspace per thread sized for the largest pair of fragments */
+static enum efp_result
+setup_workspaces(struct efp *efp)
+{
+	size_t n_ws = 1, n_lmo = 1, wf_size = 1, n_xr_atoms = 1;
+	enum efp_result res;
+
+#ifdef _OPENMP
+	n_ws = (size_t)omp_get_max_threads();
+#endif
+	if (efp->ws && n_ws <= efp->n_ws &&
+	    (efp->ws_grad || !efp->do_gradient))
+		return EFP_RESULT_SUCCESS;
+
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		const struct frag *frag = efp->frags + i;
+
+		if (frag->n_lmo > n_lmo)
+			n_lmo = frag->n_lmo;
+		if (frag->n_dynamic_polarizable_pts > n_lmo)
+			n_lmo = frag->n_dynamic_polarizable_pts;
+		if (frag->xr_wf_size > wf_size)
+			wf_size = frag->xr_wf_size;
+		if (frag->n_xr_atoms > n_xr_atoms)
+			n_xr_atoms = frag->n_xr_atoms;
+	}
+
+	free_workspaces(efp);
+
+	efp->ws = (struct workspace *)calloc(n_ws, sizeof(struct workspace));
+	if (efp->ws == NULL)
+		return EFP_RESULT_NO_MEMORY;
+
+	efp->n_ws = n_ws;
+	efp->ws_grad = efp->do_gradient;
+
+	for (size_t i = 0; i < n_ws; i++) {
+		if ((res = alloc_workspace(efp, efp->ws + i, n_lmo, wf_size,
+		    n_xr_atoms))) {
+			/* do not leave partially allocated workspaces */
+			free_workspaces(efp);
+			return res;
+		}
+	}
+
+	return EFP_RESULT_SUCCESS;
+}
+
 static enum efp_result
 copy_frag(struct frag *dest, const struct frag *src)
 {
@@ -287,6 +460,19 @@ check_opts(const struct efp_opts *opts)
 			return EFP_RESULT_FATAL;
 		}
 	}
+	if (opts->verlet_skin < 0.0) {
+		efp_log("Verlet list skin distance must not be negative");
+		return EFP_RESULT_FATAL;
+	}
+	if (opts->pol_scf_tol < 0.0) {
+		efp_log("polarization convergence threshold must not be "
+		    "negative");
+		return EFP_RESULT_FATAL;
+	}
+	if (opts->xr_int_tol < 0.0) {
+		efp_log("integral screening threshold must not be negative");
+		return EFP_RESULT_FATAL;
+	}
 	return EFP_RESULT_SUCCESS;
 }
 
@@ -369,54 +555,130 @@ do_xr(const struct efp_opts *opts)
 	return xr || cp || dd;
 }
 
+/* number of pair chunks per thread, more chunks give better load balance */
+#define PAIR_CHUNKS_PER_THREAD 16
+
+/* Terms return energies without the switching function applied and
+ * include it only in their own gradients, so that the switching function
+ * and its gradient contribution are computed once per pair. */
+static void
+compute_two_body_pair(struct efp *efp, size_t fr_i, size_t fr_j,
+    struct pair_energy *pe)
+{
+	struct workspace *ws = efp_get_workspace(efp);
+	double *s = ws->lmo_s;
+	six_t *ds = ws->lmo_ds;
+	size_t n_lmo_ij = efp->frags[fr_i].n_lmo * efp->frags[fr_j].n_lmo;
+	struct swf swf = efp_make_swf(efp, efp->frags + fr_i,
+	    efp->frags + fr_j);
+	double energy = 0.0;
+
+	memset(s, 0, n_lmo_ij * sizeof(double));
+	memset(ds, 0, n_lmo_ij * sizeof(six_t));
+
+	if (do_xr(&efp->opts)) {
+		double exr, ecp;
+
+		efp_frag_frag_xr(efp, fr_i, fr_j, &swf, s, ds, &exr, &ecp);
+		pe->xr = exr * swf.swf;
+		pe->cp = ecp * swf.swf;
+		energy += exr + ecp;
+	}
+	if (do_elec(&efp->opts)) {
+		double e = efp_frag_frag_elec(efp, fr_i, fr_j, &swf);
+
+		pe->elec = e * swf.swf;
+		energy += e;
+	}
+	if (do_disp(&efp->opts)) {
+		double e = efp_frag_frag_disp(efp, fr_i, fr_j, &swf, s, ds);
+
+		pe->disp = e * swf.swf;
+		energy += e;
+	}
+
+	if (efp->do_gradient) {
+		vec_t force = {
+			swf.dswf.x * energy,
+			swf.dswf.y * energy,
+			swf.dswf.z * energy
+		};
+
+		six_add_xyz(ws->grad + fr_i, &force);
+		six_sub_xyz(ws->grad + fr_j, &force);
+		efp_add_stress(&swf.dr, &force, ws->stress);
+	}
+}
+
+static void
+add_frag_time(struct efp *efp, size_t frag_idx, double time)
+{
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+	efp->frag_time[frag_idx] += time;
+}
+
+/* Owned pairs of fragments from the range are split into equal chunks so
+ * that the number of work units does not depend on the number of fragments
+ * and big fragments do not form a single large unit. */
 static void
 compute_two_body_range(struct efp *efp, size_t frag_from, size_t frag_to,
     void *data)
 {
 	double e_elec = 0.0, e_disp = 0.0, e_xr = 0.0, e_cp = 0.0;
+	size_t pair_from = efp_get_pair_offset(efp, frag_from);
+	size_t pair_to = efp_get_pair_offset(efp, frag_to);
+	size_t n_chunks = PAIR_CHUNKS_PER_THREAD, chunk;
 
 	(void)data;
 
+#ifdef _OPENMP
+	n_chunks *= (size_t)omp_get_max_threads();
+#endif
+	chunk = (pair_to - pair_from + n_chunks - 1) / n_chunks;
+	if (chunk == 0)
+		chunk = 1;
+	n_chunks = (pair_to - pair_from + chunk - 1) / chunk;
+
 #ifdef _OPENMP
 #pragma omp parallel for schedule(dynamic) reduction(+:e_elec,e_disp,e_xr,e_cp)
 #endif
-	for (size_t i = frag_from; i < frag_to; i++) {
-		size_t cnt = efp->n_frag % 2 ? (efp->n_frag - 1) / 2 :
-		    i < efp->n_frag / 2 ? efp->n_frag / 2 :
-		    efp->n_frag / 2 - 1;
-
-		for (size_t j = i + 1; j < i + 1 + cnt; j++) {
-			size_t fr_j = j % efp->n_frag;
-
-			if (!efp_skip_frag_pair(efp, i, fr_j)) {
-				double *s;
-				six_t *ds;
-				size_t n_lmo_ij = efp->frags[i].n_lmo *
-				    efp->frags[fr_j].n_lmo;
-
-				s = (double *)calloc(n_lmo_ij, sizeof(double));
-				ds = (six_t *)calloc(n_lmo_ij, sizeof(six_t));
-
-				if (do_xr(&efp->opts)) {
-					double exr, ecp;
-
-					efp_frag_frag_xr(efp, i, fr_j,
-					    s, ds, &exr, &ecp);
-					e_xr += exr;
-					e_cp += ecp;
-				}
-				if (do_elec(&efp->opts)) {
-					e_elec += efp_frag_frag_elec(efp,
-					    i, fr_j);
+	for (size_t c = 0; c < n_chunks; c++) {
+		size_t from = pair_from + c * chunk;
+		size_t to = from + chunk < pair_to ? from + chunk : pair_to;
+		size_t i = efp_find_pair_frag(efp, from);
+		size_t end = efp_get_pair_offset(efp, i + 1);
+		double start = efp_wtime();
+
+		for (size_t p = from; p < to; p++) {
+			if (p >= end) {
+				double now = efp_wtime();
+
+				add_frag_time(efp, i, now - start);
+				start = now;
+
+				while (p >= end) {
+					i++;
+					end = efp_get_pair_offset(efp, i + 1);
 				}
-				if (do_disp(&efp->opts)) {
-					e_disp += efp_frag_frag_disp(efp,
-					    i, fr_j, s, ds);
-				}
-				free(s);
-				free(ds);
 			}
+
+			size_t j = efp_get_pair(efp, i, p);
+			struct pair_energy pe = { 0.0, 0.0, 0.0, 0.0 };
+
+			if (!efp_skip_frag_pair(efp, i, j))
+				compute_two_body_pair(efp, i, j, &pe);
+
+			e_elec += pe.elec;
+			e_disp += pe.disp;
+			e_xr += pe.xr;
+			e_cp += pe.cp;
+
+			if (efp->pair_cache)
+				efp->pair_cache[p] = pe;
 		}
+		add_frag_time(efp, i, efp_wtime() - start);
 	}
 	efp->energy.electrostatic += e_elec;
 	efp->energy.dispersion += e_disp;
@@ -424,6 +686,130 @@ compute_two_body_range(struct efp *efp, size_t frag_from, size_t frag_to,
 	efp->energy.charge_penetration += e_cp;
 }
 
+/* Only pairs with moved fragments are recomputed. A pair of two moved
+ * fragments is handled by the one with the smaller index. */
+static void
+compute_two_body_dirty(struct efp *efp)
+{
+	double e_elec = 0.0, e_disp = 0.0, e_xr = 0.0, e_cp = 0.0;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(+:e_elec,e_disp,e_xr,e_cp)
+#endif
+	for (size_t k = 0; k < efp->n_dirty; k++) {
+		size_t i = efp->dirty_frags[k];
+		size_t n_nb = efp_get_nb_count(efp, i);
+
+		for (size_t m = 0; m < n_nb; m++) {
+			size_t j = efp_get_nb(efp, i, m);
+			size_t fr_i = i, fr_j = j, p;
+			struct pair_energy pe = { 0.0, 0.0, 0.0, 0.0 };
+
+			if (efp->frag_dirty[j] && j < i)
+				continue;
+			if (!efp_is_pair_owner(efp, i, j)) {
+				fr_i = j;
+				fr_j = i;
+			}
+			if (!efp_skip_frag_pair(efp, fr_i, fr_j))
+				compute_two_body_pair(efp, fr_i, fr_j, &pe);
+
+			p = efp_get_pair_idx(efp, fr_i, fr_j);
+
+			e_elec += pe.elec - efp->pair_cache[p].elec;
+			e_disp += pe.disp - efp->pair_cache[p].disp;
+			e_xr += pe.xr - efp->pair_cache[p].xr;
+			e_cp += pe.cp - efp->pair_cache[p].cp;
+
+			efp->pair_cache[p] = pe;
+		}
+	}
+	efp->pair_total.elec += e_elec;
+	efp->pair_total.disp += e_disp;
+	efp->pair_total.xr += e_xr;
+	efp->pair_total.cp += e_cp;
+}
+
+static enum efp_result
+setup_pair_cache(struct efp *efp)
+{
+	size_t n_pairs = efp_get_pair_offset(efp, efp->n_frag);
+
+	if (!efp->opts.enable_incremental) {
+		free(efp->pair_cache);
+		efp->pair_cache = NULL;
+		efp->pair_cache_size = 0;
+		efp->pair_cache_valid = 0;
+		return EFP_RESULT_SUCCESS;
+	}
+	if (n_pairs > efp->pair_cache_size) {
+		struct pair_energy *cache;
+
+		cache = (struct pair_energy *)realloc(efp->pair_cache,
+		    n_pairs * sizeof(struct pair_energy));
+		if (cache == NULL)
+			return EFP_RESULT_NO_MEMORY;
+
+		efp->pair_cache = cache;
+		efp->pair_cache_size = n_pairs;
+	}
+	/* pairs computed by other MPI processes are summed later */
+	memset(efp->pair_cache, 0, n_pairs * sizeof(struct pair_energy));
+	return EFP_RESULT_SUCCESS;
+}
+
+static enum efp_result
+compute_two_body(struct efp *efp)
+{
+	enum efp_result res;
+
+	if (efp->opts.enable_incremental && efp->pair_cache_valid &&
+	    !efp->do_gradient) {
+		compute_two_body_dirty(efp);
+
+		efp->energy.electrostatic = efp->pair_total.elec;
+		efp->energy.dispersion = efp->pair_total.disp;
+		efp->energy.exchange_repulsion = efp->pair_total.xr;
+		efp->energy.charge_penetration = efp->pair_total.cp;
+	} else {
+		efp->pair_cache_valid = 0;
+
+		if ((res = setup_pair_cache(efp)))
+			return res;
+
+		efp_update_cost(efp);
+		memset(efp->frag_time, 0, efp->n_frag * sizeof(double));
+
+		efp_balance_work(efp, compute_two_body_range, NULL);
+		efp_reduce_gradient(efp);
+		efp_refine_cost(efp);
+
+#ifdef EFP_USE_MPI
+		efp_allreduce(efp, &efp->energy.electrostatic, 1);
+		efp_allreduce(efp, &efp->energy.dispersion, 1);
+		efp_allreduce(efp, &efp->energy.exchange_repulsion, 1);
+		efp_allreduce(efp, &efp->energy.charge_penetration, 1);
+
+		if (efp->pair_cache)
+			efp_allreduce(efp, (double *)efp->pair_cache, 4 *
+			    efp_get_pair_offset(efp, efp->n_frag));
+#endif
+		if (efp->pair_cache) {
+			efp->pair_total.elec = efp->energy.electrostatic;
+			efp->pair_total.disp = efp->energy.dispersion;
+			efp->pair_total.xr = efp->energy.exchange_repulsion;
+			efp->pair_total.cp = efp->energy.charge_penetration;
+			efp->pair_cache_valid = 1;
+		}
+	}
+
+	for (size_t k = 0; k < efp->n_dirty; k++)
+		efp->frag_dirty[efp->dirty_frags[k]] = 0;
+
+	efp->n_dirty = 0;
+	return EFP_RESULT_SUCCESS;
+}
+
 EFP_EXPORT enum efp_result
 efp_get_energy(struct efp *efp, struct efp_energy *energy)
 {
@@ -616,7 +1002,16 @@ EFP_EXPORT enum efp_result
 efp_set_point_charges(struct efp *efp, size_t n_ptc, const double *ptc,
     const double *xyz)
 {
+	enum efp_result res;
+
 	assert(efp);
+
+	/* workspace point charge gradient buffers are sized by n_ptc */
+	if (n_ptc != efp->n_ptc)
+		if ((res = resize_workspace_grad(efp, n_ptc,
+		    efp->opts.disable_stress)))
+			return res;
+
 	efp->n_ptc = n_ptc;
 
 	if (n_ptc == 0) {
@@ -708,6 +1103,54 @@ efp_set_point_charge_values(struct efp *efp, const double *ptc)
 	return EFP_RESULT_SUCCESS;
 }
 
+static void
+mark_dirty(struct efp *efp, size_t frag_idx)
+{
+	if (efp->frag_dirty == NULL || efp->frag_dirty[frag_idx])
+		return;
+
+	efp->frag_dirty[frag_idx] = 1;
+	efp->dirty_frags[efp->n_dirty++] = frag_idx;
+}
+
+/* sets fragment position and orientation without updating its points */
+static enum efp_result
+set_frag_position(struct efp *efp, size_t frag_idx,
+    enum efp_coord_type coord_type, const double *coord)
+{
+	struct frag *frag = efp->frags + frag_idx;
+	vec_t pos = { frag->x, frag->y, frag->z };
+	mat_t rotmat = frag->rotmat;
+	enum efp_result res;
+
+	switch (coord_type) {
+	case EFP_COORD_TYPE_XYZABC:
+		res = set_coord_xyzabc(frag, coord);
+		break;
+	case EFP_COORD_TYPE_POINTS:
+		res = set_coord_points(frag, coord);
+		break;
+	case EFP_COORD_TYPE_ROTMAT:
+		res = set_coord_rotmat(frag, coord);
+		break;
+	default:
+		assert(0);
+		return EFP_RESULT_FATAL;
+	}
+
+	if (res != EFP_RESULT_SUCCESS)
+		return res;
+
+	efp_check_nblist(efp, frag_idx);
+
+	/* pairs of fragments which did not move keep cached energies */
+	if (frag->x != pos.x || frag->y != pos.y || frag->z != pos.z ||
+	    memcmp(&frag->rotmat, &rotmat, sizeof(mat_t)) != 0)
+		mark_dirty(efp, frag_idx);
+
+	return EFP_RESULT_SUCCESS;
+}
+
 EFP_EXPORT enum efp_result
 efp_set_coordinates(struct efp *efp, enum efp_coord_type coord_type,
     const double *coord)
@@ -715,8 +1158,8 @@ efp_set_coordinates(struct efp *efp, enum efp_coord_type coord_type,
 	assert(efp);
 	assert(coord);
 
-	size_t stride;
-	enum efp_result res;
+	size_t stride, n_set;
+	enum efp_result res = EFP_RESULT_SUCCESS;
 
 	switch (coord_type) {
 	case EFP_COORD_TYPE_XYZABC:
@@ -730,34 +1173,37 @@ efp_set_coordinates(struct efp *efp, enum efp_coord_type coord_type,
 		break;
 	}
 
-	for (size_t i = 0; i < efp->n_frag; i++, coord += stride)
-		if ((res = efp_set_frag_coordinates(efp, i, coord_type, coord)))
-			return res;
+	for (n_set = 0; n_set < efp->n_frag; n_set++, coord += stride)
+		if ((res = set_frag_position(efp, n_set, coord_type, coord)))
+			break;
 
-	return EFP_RESULT_SUCCESS;
+	/* on error fragments set so far are still updated to stay
+	 * consistent with their new positions */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (size_t i = 0; i < n_set; i++)
+		update_fragment(efp->frags + i);
+
+	return res;
 }
 
 EFP_EXPORT enum efp_result
 efp_set_frag_coordinates(struct efp *efp, size_t frag_idx,
     enum efp_coord_type coord_type, const double *coord)
 {
-	struct frag *frag;
+	enum efp_result res;
 
 	assert(efp);
 	assert(coord);
 	assert(frag_idx < efp->n_frag);
 
-	frag = efp->frags + frag_idx;
+	if ((res = set_frag_position(efp, frag_idx, coord_type, coord)))
+		return res;
 
-	switch (coord_type) {
-	case EFP_COORD_TYPE_XYZABC:
-		return set_coord_xyzabc(frag, coord);
-	case EFP_COORD_TYPE_POINTS:
-		return set_coord_points(frag, coord);
-	case EFP_COORD_TYPE_ROTMAT:
-		return set_coord_rotmat(frag, coord);
-	}
-	assert(0);
+	update_fragment(efp->frags + frag_idx);
+
+	return EFP_RESULT_SUCCESS;
 }
 
 EFP_EXPORT enum efp_result
@@ -821,6 +1267,8 @@ efp_set_periodic_box(struct efp *efp, double x, double y, double z)
 	efp->box.x = x;
 	efp->box.y = y;
 	efp->box.z = z;
+	efp->nb_stale = 1;
+	efp->pair_cache_valid = 0;
 
 	return EFP_RESULT_SUCCESS;
 }
@@ -849,6 +1297,11 @@ efp_get_stress_tensor(struct efp *efp, double *stress)
 		return EFP_RESULT_FATAL;
 	}
 
+	if (efp->opts.disable_stress) {
+		efp_log("stress tensor computation is disabled");
+		return EFP_RESULT_FATAL;
+	}
+
 	*(mat_t *)stress = efp->stress;
 
 	return EFP_RESULT_SUCCESS;
@@ -880,6 +1333,8 @@ efp_get_ai_screen(struct efp *efp, size_t frag_idx, double *screen)
 EFP_EXPORT enum efp_result
 efp_prepare(struct efp *efp)
 {
+	enum efp_result res;
+
 	assert(efp);
 
 	efp->n_polarizable_pts = 0;
@@ -893,8 +1348,21 @@ efp_prepare(struct efp *efp)
 	efp->indipconj = (vec_t *)calloc(efp->n_polarizable_pts, sizeof(vec_t));
 	efp->grad = (six_t *)calloc(efp->n_frag, sizeof(six_t));
 	efp->skiplist = (char *)calloc(efp->n_frag * efp->n_frag, 1);
+	efp->frag_cost = (double *)calloc(efp->n_frag, sizeof(double));
+	efp->frag_time = (double *)calloc(efp->n_frag, sizeof(double));
+	efp->frag_dirty = (char *)calloc(efp->n_frag, 1);
+	efp->dirty_frags = (size_t *)calloc(efp->n_frag, sizeof(size_t));
+	efp->frag_owner = (int *)calloc(efp->n_frag, sizeof(int));
+	efp->own_frags = (size_t *)calloc(efp->n_frag, sizeof(size_t));
+	efp->nb_stale = 1;
+	efp->halo_stale = 1;
+
+	efp_update_cost(efp);
+
+	if ((res = efp_setup_disp(efp)))
+		return res;
 
-	return EFP_RESULT_SUCCESS;
+	return setup_workspaces(efp);
 }
 
 EFP_EXPORT enum efp_result
@@ -946,14 +1414,57 @@ efp_get_wavefunction_dependent_energy(struct efp *efp, double *energy)
 	assert(efp);
 	assert(energy);
 
+	enum efp_result res;
+
 	if (!(efp->opts.terms & EFP_TERM_POL) &&
 	    !(efp->opts.terms & EFP_TERM_AI_POL)) {
 		*energy = 0.0;
 		return EFP_RESULT_SUCCESS;
 	}
+	if ((res = efp_update_nblist(efp)))
+		return res;
+	if ((res = setup_workspaces(efp)))
+		return res;
+
 	return efp_compute_pol_energy(efp, energy);
 }
 
+/* brings stale fragment state needed by enabled terms up to date */
+static void
+update_stale_state(struct efp *efp)
+{
+	unsigned need = 0;
+
+	if (do_xr(&efp->opts)) {
+		need |= FRAG_STALE_XR_WF;
+
+		if (efp->do_gradient)
+			need |= FRAG_STALE_XR_WF_DERIV;
+	}
+	if (efp->opts.terms & EFP_TERM_AI_DISP)
+		need |= FRAG_STALE_DISP_TENSORS;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		struct frag *frag = efp->frags + i;
+		unsigned upd = frag->stale & need;
+
+		/* fragments without neighbors have no exchange repulsion */
+		if (efp_get_nb_count(efp, i) == 0)
+			upd &= ~(FRAG_STALE_XR_WF | FRAG_STALE_XR_WF_DERIV);
+
+		if (upd & (FRAG_STALE_XR_WF | FRAG_STALE_XR_WF_DERIV))
+			efp_update_xr_wf(frag, upd & FRAG_STALE_XR_WF,
+			    upd & FRAG_STALE_XR_WF_DERIV);
+		if (upd & FRAG_STALE_DISP_TENSORS)
+			efp_update_disp_tensors(frag);
+
+		frag->stale &= ~upd;
+	}
+}
+
 EFP_EXPORT enum efp_result
 efp_compute(struct efp *efp, int do_gradient)
 {
@@ -970,14 +1481,20 @@ efp_compute(struct efp *efp, int do_gradient)
 
 	if ((res = check_params(efp)))
 		return res;
+	if ((res = efp_update_nblist(efp)))
+		return res;
+	if ((res = setup_workspaces(efp)))
+		return res;
+
+	update_stale_state(efp);
 
 	memset(&efp->energy, 0, sizeof(efp->energy));
 	memset(&efp->stress, 0, sizeof(efp->stress));
 	memset(efp->grad, 0, efp->n_frag * sizeof(six_t));
 	memset(efp->ptc_grad, 0, efp->n_ptc * sizeof(vec_t));
 
-	efp_balance_work(efp, compute_two_body_range, NULL);
-
+	if ((res = compute_two_body(efp)))
+		return res;
 	if ((res = efp_compute_pol(efp)))
 		return res;
 	if ((res = efp_compute_ai_elec(efp)))
@@ -986,15 +1503,10 @@ efp_compute(struct efp *efp, int do_gradient)
 		return res;
 
 #ifdef EFP_USE_MPI
-	efp_allreduce(&efp->energy.electrostatic, 1);
-	efp_allreduce(&efp->energy.dispersion, 1);
-	efp_allreduce(&efp->energy.exchange_repulsion, 1);
-	efp_allreduce(&efp->energy.charge_penetration, 1);
-
 	if (efp->do_gradient) {
-		efp_allreduce((double *)efp->grad, 6 * efp->n_frag);
-		efp_allreduce((double *)efp->ptc_grad, 3 * efp->n_ptc);
-		efp_allreduce((double *)&efp->stress, 9);
+		efp_allreduce(efp, (double *)efp->grad, 6 * efp->n_frag);
+		efp_allreduce(efp, (double *)efp->ptc_grad, 3 * efp->n_ptc);
+		efp_allreduce(efp, (double *)&efp->stress, 9);
 	}
 #endif
 	efp->energy.total = efp->energy.electrostatic +
@@ -1167,6 +1679,28 @@ efp_get_induced_dipole_conj_values(struct efp *efp, double *dip)
 	return EFP_RESULT_SUCCESS;
 }
 
+EFP_EXPORT enum efp_result
+efp_set_induced_dipole_values(struct efp *efp, const double *dip)
+{
+	assert(efp);
+	assert(dip);
+
+	memcpy(efp->indip, dip, efp->n_polarizable_pts * sizeof(vec_t));
+	efp->n_pol_hist = 0;
+	return EFP_RESULT_SUCCESS;
+}
+
+EFP_EXPORT enum efp_result
+efp_set_induced_dipole_conj_values(struct efp *efp, const double *dip)
+{
+	assert(efp);
+	assert(dip);
+
+	memcpy(efp->indipconj, dip, efp->n_polarizable_pts * sizeof(vec_t));
+	efp->n_pol_hist = 0;
+	return EFP_RESULT_SUCCESS;
+}
+
 EFP_EXPORT enum efp_result
 efp_get_lmo_count(struct efp *efp, size_t frag_idx, size_t *n_lmo)
 {
@@ -1238,6 +1772,31 @@ efp_shutdown(struct efp *efp)
 	free(efp->ai_orbital_energies);
 	free(efp->ai_dipole_integrals);
 	free(efp->skiplist);
+	free(efp->nb_offset);
+	free(efp->nb_frags);
+	free(efp->pair_offset);
+	free(efp->pair_frags);
+	free(efp->nb_xyz);
+	free(efp->frag_cost);
+	free(efp->frag_time);
+	free(efp->pair_cache);
+	free(efp->frag_dirty);
+	free(efp->dirty_frags);
+	free(efp->pol_offset);
+	free(efp->pol_tensors);
+	free(efp->pol_built);
+	free(efp->pol_hist);
+	free(efp->pol_opt);
+	free(efp->disp_c6_offset);
+	free(efp->disp_c6);
+	free(efp->frag_owner);
+	free(efp->own_frags);
+	efp_free_halo(efp);
+	free_workspaces(efp);
+#ifdef EFP_USE_MPI
+	if (efp->steal_win != MPI_WIN_NULL)
+		MPI_Win_free(&efp->steal_win);
+#endif
 	free(efp);
 }
 
@@ -1252,7 +1811,50 @@ efp_set_opts(struct efp *efp, const struct efp_opts *opts)
 	if ((res = check_opts(opts)))
 		return res;
 
+	/* stress accumulators depend on options */
+	if (opts->disable_stress != efp->opts.disable_stress)
+		if ((res = resize_workspace_grad(efp, efp->n_ptc,
+		    opts->disable_stress)))
+			return res;
+
+	struct efp_opts old_opts = efp->opts;
+
 	efp->opts = *opts;
+
+	/* cached pair energies and measured costs depend on the model */
+	if (opts->terms != old_opts.terms ||
+	    opts->elec_damp != old_opts.elec_damp ||
+	    opts->disp_damp != old_opts.disp_damp ||
+	    opts->pol_damp != old_opts.pol_damp ||
+	    opts->pol_driver != old_opts.pol_driver ||
+	    opts->enable_cutoff != old_opts.enable_cutoff ||
+	    opts->swf_cutoff != old_opts.swf_cutoff ||
+	    opts->enable_pbc != old_opts.enable_pbc ||
+	    opts->xr_int_tol != old_opts.xr_int_tol) {
+		efp->cost_measured = 0;
+		efp->pair_cache_valid = 0;
+	}
+
+	/* neighbor lists depend on cutoff and periodicity */
+	if (opts->enable_cutoff != old_opts.enable_cutoff ||
+	    opts->swf_cutoff != old_opts.swf_cutoff ||
+	    opts->verlet_skin != old_opts.verlet_skin ||
+	    opts->enable_pbc != old_opts.enable_pbc)
+		efp->nb_stale = 1;
+
+	/* distributed polarization depends on cutoff and driver */
+	if (opts->enable_cutoff != old_opts.enable_cutoff ||
+	    opts->pol_driver != old_opts.pol_driver)
+		efp->halo_stale = 1;
+
+	/* history size depends on options */
+	if (opts->pol_history != old_opts.pol_history ||
+	    opts->pol_driver != old_opts.pol_driver) {
+		free(efp->pol_hist);
+		efp->pol_hist = NULL;
+		efp->n_pol_hist = 0;
+	}
+
 	return EFP_RESULT_SUCCESS;
 }
 
@@ -1266,6 +1868,27 @@ efp_get_opts(struct efp *efp, struct efp_opts *opts)
 	return EFP_RESULT_SUCCESS;
 }
 
+#ifdef EFP_USE_MPI
+EFP_EXPORT enum efp_result
+efp_set_mpi_comm(struct efp *efp, MPI_Comm comm)
+{
+	assert(efp);
+
+	if (comm == MPI_COMM_NULL) {
+		efp_log("invalid MPI communicator");
+		return EFP_RESULT_FATAL;
+	}
+
+	/* window belongs to the previous communicator */
+	if (efp->steal_win != MPI_WIN_NULL)
+		MPI_Win_free(&efp->steal_win);
+
+	efp->mpi_comm = comm;
+	efp->halo_stale = 1;
+	return EFP_RESULT_SUCCESS;
+}
+#endif
+
 EFP_EXPORT void
 efp_opts_default(struct efp_opts *opts)
 {
@@ -1331,6 +1954,7 @@ efp_skip_fragments(struct efp *efp, size_t i, size_t j, int value)
 
 	efp->skiplist[i * efp->n_frag + j] = value ? 1 : 0;
 	efp->skiplist[j * efp->n_frag + i] = value ? 1 : 0;
+	efp->pair_cache_valid = 0;
 
 	return EFP_RESULT_SUCCESS;
 }
@@ -1345,6 +1969,10 @@ efp_create(void)
 
 	efp_opts_default(&efp->opts);
 
+#ifdef EFP_USE_MPI
+	efp->mpi_comm = MPI_COMM_WORLD;
+	efp->steal_win = MPI_WIN_NULL;
+#endif
 	return efp;
 }
 
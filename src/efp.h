@@ -29,6 +29,10 @@
 
 #include <stddef.h>
 
+#ifdef EFP_USE_MPI
+#include <mpi.h>
+#endif
+
 /** \file efp.h
  * Public libefp interface.
  *
@@ -119,7 +123,13 @@ enum efp_pol_driver {
 	/** Iterative solution of polarization equations. */
 	EFP_POL_DRIVER_ITERATIVE = 0,
 	/** Direct solution of polarization equations. */
-	EFP_POL_DRIVER_DIRECT
+	EFP_POL_DRIVER_DIRECT,
+	/** Preconditioned conjugate gradient solution of polarization
+	 * equations. */
+	EFP_POL_DRIVER_CG,
+	/** Approximate induced dipoles from extrapolated perturbation theory
+	 * (OPT3). Cost is fixed and there is no convergence check. */
+	EFP_POL_DRIVER_OPT
 };
 
 /** \struct efp
@@ -150,6 +160,54 @@ struct efp_opts {
 	int enable_cutoff;
 	/** Cutoff distance for fragment-fragment interactions. */
 	double swf_cutoff;
+	/** Skin distance for Verlet neighbor lists. If nonzero, neighbor
+	 * lists include fragments within cutoff plus skin distance and are
+	 * only rebuilt after some fragment moves by more than half of the
+	 * skin. If zero, lists are rebuilt after every change of
+	 * coordinates. */
+	double verlet_skin;
+	/** Do not compute the stress tensor during gradient calculation if
+	 * nonzero. In this case efp_get_stress_tensor returns an error. */
+	int disable_stress;
+	/** Let MPI processes take work from other processes after they
+	 * finish their own share if nonzero. Has no effect without MPI. */
+	int enable_work_stealing;
+	/** Keep energies of fragment pairs between calls to efp_compute if
+	 * nonzero. Energy-only computations then update only pairs which
+	 * involve fragments moved since the previous call. Memory use is
+	 * proportional to the number of interacting pairs. Gradient
+	 * computations always include all pairs. */
+	int enable_incremental;
+	/** Convergence threshold for iterative polarization solvers. If zero,
+	 * the default value of 1.0e-10 is used. */
+	double pol_scf_tol;
+	/** Maximum number of iterations of iterative polarization solvers.
+	 * If zero, the default value of 80 is used. */
+	size_t pol_scf_max_iter;
+	/** Do not store dipole field tensors between polarizable points
+	 * during solution of polarization equations if nonzero. Tensors
+	 * are only stored if interaction cutoff is enabled. They take 56
+	 * bytes per pair of polarizable points within the cutoff and make
+	 * each iteration of polarization solvers several times faster. */
+	int disable_pol_cache;
+	/** Number of previous induced dipole solutions used for the initial
+	 * guess of iterative polarization solvers in efp_compute. If zero or
+	 * one, solvers start from the last solution. Larger values
+	 * extrapolate from the last pol_history solutions using the always
+	 * stable predictor-corrector (ASPC) coefficients, which is useful
+	 * for molecular dynamics. */
+	size_t pol_history;
+	/** Do not fail if iterative polarization solvers do not converge in
+	 * pol_scf_max_iter iterations if nonzero. Energy and gradient are
+	 * then computed from the last iterate. This is intended for induced
+	 * dipoles propagated by the caller as dynamical variables, see
+	 * efp_set_induced_dipole_values. */
+	int disable_pol_conv_check;
+	/** Threshold for prescreening of overlap and kinetic energy
+	 * integrals in exchange repulsion. Pairs of atoms, shells and
+	 * primitives with estimated integrals below this value are
+	 * skipped. If zero, the default value of 1.0e-20 is used. */
+	double xr_int_tol;
 };
 
 /** EFP energy terms. */
@@ -284,6 +342,28 @@ enum efp_result efp_set_opts(struct efp *efp, const struct efp_opts *opts);
  */
 enum efp_result efp_get_opts(struct efp *efp, struct efp_opts *opts);
 
+#ifdef EFP_USE_MPI
+/**
+ * Set MPI communicator used to distribute work.
+ *
+ * Declared only if \a EFP_USE_MPI is defined, which must be done by the
+ * calling program if libefp was compiled with MPI support.
+ *
+ * By default MPI_COMM_WORLD is used. All libefp calls which do computations
+ * must then be made on every process of the communicator. The communicator
+ * is not duplicated and must remain valid while the efp object is used.
+ * This function should be called on all processes which used the efp object
+ * before.
+ *
+ * \param[in] efp The efp structure.
+ *
+ * \param[in] comm MPI communicator.
+ *
+ * \return ::EFP_RESULT_SUCCESS on success or error code otherwise.
+ */
+enum efp_result efp_set_mpi_comm(struct efp *efp, MPI_Comm comm);
+#endif
+
 /**
  * Add EFP potential from a file.
  *
@@ -814,6 +894,35 @@ enum efp_result efp_get_induced_dipole_values(struct efp *efp, double *dip);
 enum efp_result efp_get_induced_dipole_conj_values(struct efp *efp,
     double *dip);
 
+/**
+ * Set values of polarization induced dipoles.
+ *
+ * Iterative polarization solvers start from these values in the next call to
+ * ::efp_compute. Previous solutions stored for extrapolation of the initial
+ * guess (see efp_opts::pol_history) are discarded.
+ *
+ * \param[in] efp The efp structure.
+ *
+ * \param[in] dip Array with [3 * \p n_dip] elements with induced dipoles.
+ *
+ * \return ::EFP_RESULT_SUCCESS on success or error code otherwise.
+ */
+enum efp_result efp_set_induced_dipole_values(struct efp *efp,
+    const double *dip);
+
+/**
+ * Set values of polarization conjugated induced dipoles.
+ *
+ * \param[in] efp The efp structure.
+ *
+ * \param[in] dip Array with [3 * \p n_dip] elements with conjugated induced
+ * dipoles.
+ *
+ * \return ::EFP_RESULT_SUCCESS on success or error code otherwise.
+ */
+enum efp_result efp_set_induced_dipole_conj_values(struct efp *efp,
+    const double *dip);
+
 /**
  * Get the number of LMOs in a fragment.
  *
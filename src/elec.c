@@ -104,6 +104,7 @@ static void
 atom_mult_grad(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
     size_t atom_i_idx, size_t pt_j_idx, const struct swf *swf)
 {
+	struct workspace *ws = efp_get_workspace(efp);
 	const struct frag *fr_i = efp->frags + fr_i_idx;
 	const struct frag *fr_j = efp->frags + fr_j_idx;
 	const struct efp_atom *at_i = fr_i->atoms + atom_i_idx;
@@ -154,11 +155,11 @@ atom_mult_grad(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
 	vec_scale(&torque_i, swf->swf);
 	vec_scale(&torque_j, swf->swf);
 
-	efp_add_force(efp->grad + fr_i_idx, CVEC(fr_i->x), CVEC(at_i->x),
+	efp_add_force(ws->grad + fr_i_idx, CVEC(fr_i->x), CVEC(at_i->x),
 	    &force, &torque_i);
-	efp_sub_force(efp->grad + fr_j_idx, CVEC(fr_j->x), CVEC(pt_j->x),
+	efp_sub_force(ws->grad + fr_j_idx, CVEC(fr_j->x), CVEC(pt_j->x),
 	    &force, &torque_j);
-	efp_add_stress(&swf->dr, &force, &efp->stress);
+	efp_add_stress(&swf->dr, &force, ws->stress);
 }
 
 static double
@@ -234,6 +235,7 @@ static void
 mult_mult_grad(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
     size_t pt_i_idx, size_t pt_j_idx, const struct swf *swf)
 {
+	struct workspace *ws = efp_get_workspace(efp);
 	struct frag *fr_i = efp->frags + fr_i_idx;
 	struct frag *fr_j = efp->frags + fr_j_idx;
 	struct multipole_pt *pt_i = fr_i->multipole_pts + pt_i_idx;
@@ -325,19 +327,20 @@ mult_mult_grad(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
 	vec_scale(&torque_i, swf->swf);
 	vec_scale(&torque_j, swf->swf);
 
-	efp_add_force(efp->grad + fr_i_idx, CVEC(fr_i->x), CVEC(pt_i->x),
+	efp_add_force(ws->grad + fr_i_idx, CVEC(fr_i->x), CVEC(pt_i->x),
 	    &force, &torque_i);
-	efp_sub_force(efp->grad + fr_j_idx, CVEC(fr_j->x), CVEC(pt_j->x),
+	efp_sub_force(ws->grad + fr_j_idx, CVEC(fr_j->x), CVEC(pt_j->x),
 	    &force, &torque_j);
-	efp_add_stress(&swf->dr, &force, &efp->stress);
+	efp_add_stress(&swf->dr, &force, ws->stress);
 }
 
 double
-efp_frag_frag_elec(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx)
+efp_frag_frag_elec(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
+    const struct swf *swf)
 {
+	struct workspace *ws = efp_get_workspace(efp);
 	struct frag *fr_i = efp->frags + fr_i_idx;
 	struct frag *fr_j = efp->frags + fr_j_idx;
-	struct swf swf = efp_make_swf(efp, fr_i, fr_j);
 	double energy = 0.0;
 
 	/* nuclei - nuclei */
@@ -347,9 +350,9 @@ efp_frag_frag_elec(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx)
 			struct efp_atom *at_j = fr_j->atoms + jj;
 
 			vec_t dr = {
-				at_j->x - at_i->x - swf.cell.x,
-				at_j->y - at_i->y - swf.cell.y,
-				at_j->z - at_i->z - swf.cell.z
+				at_j->x - at_i->x - swf->cell.x,
+				at_j->y - at_i->y - swf->cell.y,
+				at_j->z - at_i->z - swf->cell.z
 			};
 
 			energy += efp_charge_charge_energy(at_i->znuc,
@@ -359,12 +362,12 @@ efp_frag_frag_elec(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx)
 
 				efp_charge_charge_grad(at_i->znuc, at_j->znuc,
 				    &dr, &force, &add_i, &add_j);
-				vec_scale(&force, swf.swf);
-				efp_add_force(efp->grad + fr_i_idx,
+				vec_scale(&force, swf->swf);
+				efp_add_force(ws->grad + fr_i_idx,
 				    CVEC(fr_i->x), CVEC(at_i->x), &force, NULL);
-				efp_sub_force(efp->grad + fr_j_idx,
+				efp_sub_force(ws->grad + fr_j_idx,
 				    CVEC(fr_j->x), CVEC(at_j->x), &force, NULL);
-				efp_add_stress(&swf.dr, &force, &efp->stress);
+				efp_add_stress(&swf->dr, &force, ws->stress);
 			}
 		}
 	}
@@ -373,10 +376,10 @@ efp_frag_frag_elec(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx)
 	for (size_t ii = 0; ii < fr_i->n_atoms; ii++) {
 		for (size_t jj = 0; jj < fr_j->n_multipole_pts; jj++) {
 			energy += atom_mult_energy(efp, fr_i, fr_j,
-			    ii, jj, &swf);
+			    ii, jj, swf);
 			if (efp->do_gradient) {
 				atom_mult_grad(efp, fr_i_idx, fr_j_idx,
-				    ii, jj, &swf);
+				    ii, jj, swf);
 			}
 		}
 	}
@@ -384,7 +387,7 @@ efp_frag_frag_elec(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx)
 	/* mult points - nuclei */
 	for (size_t jj = 0; jj < fr_j->n_atoms; jj++) {
 		for (size_t ii = 0; ii < fr_i->n_multipole_pts; ii++) {
-			struct swf swf2 = swf;
+			struct swf swf2 = *swf;
 
 			vec_negate(&swf2.cell);
 			vec_negate(&swf2.dr);
@@ -403,25 +406,15 @@ efp_frag_frag_elec(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx)
 	for (size_t ii = 0; ii < fr_i->n_multipole_pts; ii++) {
 		for (size_t jj = 0; jj < fr_j->n_multipole_pts; jj++) {
 			energy += mult_mult_energy(efp, fr_i_idx, fr_j_idx,
-			    ii, jj, &swf);
+			    ii, jj, swf);
 			if (efp->do_gradient) {
 				mult_mult_grad(efp, fr_i_idx, fr_j_idx,
-				    ii, jj, &swf);
+				    ii, jj, swf);
 			}
 		}
 	}
 
-	vec_t force = {
-		swf.dswf.x * energy,
-		swf.dswf.y * energy,
-		swf.dswf.z * energy
-	};
-
-	six_atomic_add_xyz(efp->grad + fr_i_idx, &force);
-	six_atomic_sub_xyz(efp->grad + fr_j_idx, &force);
-	efp_add_stress(&swf.dr, &force, &efp->stress);
-
-	return energy * swf.swf;
+	return energy;
 }
 
 static void
@@ -566,6 +559,7 @@ compute_ai_elec_frag(struct efp *efp, size_t frag_idx)
 static void
 compute_ai_elec_frag_grad(struct efp *efp, size_t frag_idx)
 {
+	struct workspace *ws = efp_get_workspace(efp);
 	struct frag *fr_j = efp->frags + frag_idx;
 	vec_t force, add_i, add_j, force_, add_i_, add_j_;
 
@@ -577,8 +571,8 @@ compute_ai_elec_frag_grad(struct efp *efp, size_t frag_idx)
 
 			efp_charge_charge_grad(efp->ptc[i], at_j->znuc, &dr,
 			    &force, &add_i, &add_j);
-			vec_atomic_add(efp->ptc_grad + i, &force);
-			efp_sub_force(efp->grad + frag_idx, CVEC(fr_j->x),
+			ws->ptc_grad[i] = vec_add(ws->ptc_grad + i, &force);
+			efp_sub_force(ws->grad + frag_idx, CVEC(fr_j->x),
 			    CVEC(at_j->x), &force, &add_j);
 		}
 
@@ -616,8 +610,8 @@ compute_ai_elec_frag_grad(struct efp *efp, size_t frag_idx)
 			add_3(&force, &force_, &add_i, &add_i_,
 			    &add_j, &add_j_);
 
-			vec_atomic_add(efp->ptc_grad + i, &force);
-			efp_sub_force(efp->grad + frag_idx, CVEC(fr_j->x),
+			ws->ptc_grad[i] = vec_add(ws->ptc_grad + i, &force);
+			efp_sub_force(ws->grad + frag_idx, CVEC(fr_j->x),
 			    CVEC(pt_j->x), &force, &add_j);
 		}
 	}
@@ -648,7 +642,8 @@ efp_compute_ai_elec(struct efp *efp)
 		return EFP_RESULT_SUCCESS;
 
 	efp_balance_work(efp, compute_ai_elec_range, NULL);
-	efp_allreduce(&efp->energy.electrostatic_point_charges, 1);
+	efp_reduce_gradient(efp);
+	efp_allreduce(efp, &efp->energy.electrostatic_point_charges, 1);
 
 	return EFP_RESULT_SUCCESS;
 }
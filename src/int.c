@@ -28,13 +28,9 @@
 #include <string.h>
 
 #include "int.h"
-#include "intshift.h"
 
 /* Overlap and kinetic energy integral computation routines. */
 
-/* Tolerance for integrals (20 * ln10) */
-static const double int_tol = 46.051701859881;
-
 /* Normalization constants */
 static const double int_norm[] = {
 	1.0000000000000000, 1.0000000000000000,
@@ -49,6 +45,20 @@ static const double int_norm[] = {
 	2.2360679774997898, 3.8729833462074232
 };
 
+/* Cartesian powers of functions in the order GAMESS stores them */
+static const size_t func_x[] = { 0, 1, 0, 0, 2, 0, 0, 1, 1, 0,
+				 3, 0, 0, 2, 2, 1, 0, 1, 0, 1 };
+static const size_t func_y[] = { 0, 0, 1, 0, 0, 2, 0, 1, 0, 1,
+				 0, 3, 0, 1, 0, 2, 2, 0, 1, 1 };
+static const size_t func_z[] = { 0, 0, 0, 1, 0, 0, 2, 0, 1, 1,
+				 0, 0, 3, 0, 1, 0, 1, 2, 2, 1 };
+
+/* Sizes of one-dimensional integral tables: powers up to F on center i
+ * plus one for derivatives, up to F on center j plus two for kinetic
+ * energy integrals. */
+#define OS_DIM_I 5
+#define OS_DIM_J 6
+
 static void
 set_coef(double *con, char type, const double *coef)
 {
@@ -74,117 +84,6 @@ set_coef(double *con, char type, const double *coef)
 	}
 }
 
-static void
-make_int(size_t ni, size_t nj, double tt, const vec_t *p, const vec_t *p_i,
-    const vec_t *p_j, vec_t *out)
-{
-	static const size_t imin[] = { 0, 1, 3,  6, 10, 15, 21, 28, 36, 45 };
-	static const size_t imax[] = { 1, 3, 6, 10, 15, 21, 28, 36, 45, 55 };
-
-	static const double h[] = {
-		 0.0000000000000000, -0.7071067811865475,  0.7071067811865475,
-		-1.2247448713915889,  0.0000000000000000,  1.2247448713915889,
-		-1.6506801238857844, -0.5246476232752903,  0.5246476232752903,
-		 1.6506801238857844, -2.0201828704560856, -0.9585724646138185,
-		 0.0000000000000000,  0.9585724646138185,  2.0201828704560856,
-		-2.3506049736744923, -1.3358490740136970, -0.4360774119276165,
-		 0.4360774119276165,  1.3358490740136970,  2.3506049736744923,
-		-2.6519613568352334, -1.6735516287674714, -0.8162878828589647,
-		 0.0000000000000000,  0.8162878828589647,  1.6735516287674714,
-		 2.6519613568352334
-	};
-	static const double w[] = {
-		 1.7724538509055161,  0.8862269254527580,  0.8862269254527580,
-		 0.2954089751509193,  1.1816359006036774,  0.2954089751509193,
-		 0.0813128354472451,  0.8049140900055128,  0.8049140900055128,
-		 0.0813128354472451,  0.0199532420590459,  0.3936193231522411,
-		 0.9453087204829419,  0.3936193231522411,  0.0199532420590459,
-		 0.0045300099055088,  0.1570673203228566,  0.7246295952243925,
-		 0.7246295952243925,  0.1570673203228566,  0.0045300099055088,
-		 0.0009717812450995,  0.0545155828191270,  0.4256072526101277,
-		 0.8102646175568073,  0.4256072526101277,  0.0545155828191270,
-		 0.0009717812450995
-	};
-
-	size_t npts = (ni + nj) / 2;
-	double xint = 0.0, yint = 0.0, zint = 0.0;
-
-	for (size_t i = imin[npts]; i < imax[npts]; i++) {
-		double px = w[i];
-		double py = w[i];
-		double pz = w[i];
-		double tmp = h[i] * tt;
-
-		if(ni > 0) {
-			double ax = tmp + p->x - p_i->x;
-			double ay = tmp + p->y - p_i->y;
-			double az = tmp + p->z - p_i->z;
-
-			/* loop unrolling */
-			switch (ni) {
-			case 4:
-				px *= ax;
-				py *= ay;
-				pz *= az;
-			case 3:
-				px *= ax;
-				py *= ay;
-				pz *= az;
-			case 2:
-				px *= ax;
-				py *= ay;
-				pz *= az;
-			case 1:
-				px *= ax;
-				py *= ay;
-				pz *= az;
-				break;
-			default:
-				abort();
-			}
-		}
-
-		if(nj > 0) {
-			double bx = tmp + p->x - p_j->x;
-			double by = tmp + p->y - p_j->y;
-			double bz = tmp + p->z - p_j->z;
-
-			/* loop unrolling */
-			switch (nj) {
-			case 5:
-				px *= bx;
-				py *= by;
-				pz *= bz;
-			case 4:
-				px *= bx;
-				py *= by;
-				pz *= bz;
-			case 3:
-				px *= bx;
-				py *= by;
-				pz *= bz;
-			case 2:
-				px *= bx;
-				py *= by;
-				pz *= bz;
-			case 1:
-				px *= bx;
-				py *= by;
-				pz *= bz;
-				break;
-			default:
-				abort();
-			}
-		}
-		xint += px;
-		yint += py;
-		zint += pz;
-	}
-	out->x = xint;
-	out->y = yint;
-	out->z = zint;
-}
-
 static size_t
 get_shell_idx(char type)
 {
@@ -230,223 +129,144 @@ get_shell_sl(size_t shell_idx)
 	return sl[shell_idx];
 }
 
-static void
-init_ft(size_t count_i, char type_j, double *ft)
-{
-	switch (type_j) {
-	case 'S':
-		for (size_t i = 0; i < count_i; i++) {
-			*ft++ = 3.0;
-		}
-		return;
-	case 'L':
-		for (size_t i = 0; i < count_i; i++) {
-			*ft++ = 3.0;
-			*ft++ = 5.0;
-			*ft++ = 5.0;
-			*ft++ = 5.0;
-		}
-		return;
-	case 'P':
-		for (size_t i = 0; i < count_i; i++) {
-			*ft++ = 5.0;
-			*ft++ = 5.0;
-			*ft++ = 5.0;
-		}
-		return;
-	case 'D':
-		for (size_t i = 0; i < count_i; i++) {
-			*ft++ = 7.0;
-			*ft++ = 7.0;
-			*ft++ = 7.0;
-			*ft++ = 7.0;
-			*ft++ = 7.0;
-			*ft++ = 7.0;
-		}
-		return;
-	case 'F':
-		for (size_t i = 0; i < count_i; i++) {
-			*ft++ = 9.0;
-			*ft++ = 9.0;
-			*ft++ = 9.0;
-			*ft++ = 9.0;
-			*ft++ = 9.0;
-			*ft++ = 9.0;
-			*ft++ = 9.0;
-			*ft++ = 9.0;
-			*ft++ = 9.0;
-			*ft++ = 9.0;
-		}
-		return;
-	}
-	abort();
-}
-
 void
-efp_st_int(size_t n_atoms_i, const struct xr_atom *atoms_i, size_t n_atoms_j,
-    const struct xr_atom *atoms_j, size_t stride, double *s, double *t)
+efp_set_shell_extents(struct xr_atom *atom)
 {
-	double ft[100], dij[100], sblk[100], tblk[100];
-	double xin[90], yin[90], zin[90];
-
-	for (size_t iii = 0, loc_i = 0; iii < n_atoms_i; iii++) {
-		const struct xr_atom *at_i = atoms_i + iii;
-
-	/* shell i */
-	for (size_t ii = 0; ii < at_i->n_shells; ii++) {
-		const struct shell *sh_i = at_i->shells + ii;
-		size_t type_i = get_shell_idx(sh_i->type);
-		size_t start_i = get_shell_start(type_i);
-		size_t end_i = get_shell_end(type_i);
-		size_t sl_i = get_shell_sl(type_i);
-		size_t count_i = end_i - start_i;
-
-		for (size_t jjj = 0, loc_j = 0; jjj < n_atoms_j; jjj++) {
-			const struct xr_atom *at_j = atoms_j + jjj;
-
-		/* shell j */
-		for (size_t jj = 0; jj < at_j->n_shells; jj++) {
-			const struct shell *sh_j = at_j->shells + jj;
-			size_t type_j = get_shell_idx(sh_j->type);
-			size_t start_j = get_shell_start(type_j);
-			size_t end_j = get_shell_end(type_j);
-			size_t sl_j = get_shell_sl(type_j);
-			size_t count_j = end_j - start_j;
-			size_t count = count_i * count_j;
+	atom->min_exp = HUGE_VAL;
+	atom->log_coef = -HUGE_VAL;
 
-			memset(sblk, 0, count * sizeof(double));
-			memset(tblk, 0, count * sizeof(double));
+	for (size_t i = 0; i < atom->n_shells; i++) {
+		struct shell *sh = atom->shells + i;
+		const double *coef = sh->coef;
+		double max_coef = 0.0;
 
-			init_ft(count_i, sh_j->type, ft);
+		sh->min_exp = HUGE_VAL;
 
-			const size_t *shift_x = shift_table_x[type_i*5+type_j];
-			const size_t *shift_y = shift_table_y[type_i*5+type_j];
-			const size_t *shift_z = shift_table_z[type_i*5+type_j];
-			const double *coef_i = sh_i->coef;
-			double rr = vec_dist_2(CVEC(at_i->x), CVEC(at_j->x));
-
-			/* primitive i */
-			for (size_t ig = 0; ig < sh_i->n_funcs; ig++) {
-				double ai = *coef_i++;
-				double con_i[20], con_j[20];
+		for (size_t k = 0; k < sh->n_funcs; k++) {
+			if (*coef < sh->min_exp)
+				sh->min_exp = *coef;
+			coef++;
 
-				set_coef(con_i, sh_i->type, coef_i);
-				coef_i++;
-				if (sh_i->type == 'L')
-					coef_i++;
+			size_t n_con = sh->type == 'L' ? 2 : 1;
 
-				const double *coef_j = sh_j->coef;
+			for (size_t l = 0; l < n_con; l++, coef++)
+				if (fabs(*coef) > max_coef)
+					max_coef = fabs(*coef);
+		}
+		sh->log_coef = log(max_coef);
 
-				/* primitive j */
-				for (size_t jg = 0; jg < sh_j->n_funcs; jg++) {
-					double aj = *coef_j++;
-					double aa = 1.0 / (ai + aj);
-					double tmp = aj * ai * rr * aa;
+		if (sh->min_exp < atom->min_exp)
+			atom->min_exp = sh->min_exp;
+		if (sh->log_coef > atom->log_coef)
+			atom->log_coef = sh->log_coef;
+	}
+}
 
-					if (tmp > int_tol) {
-						coef_j++;
-						if (sh_j->type == 'L')
-							coef_j++;
-						continue;
-					}
+/* Returns nonzero if all primitive pairs of two shells or atoms are below
+ * integral tolerance. The exponential factor decreases as exponents grow,
+ * so the pair of smallest exponents gives an upper bound. */
+static int
+screen_pair(double min_exp_i, double log_coef_i, double min_exp_j,
+    double log_coef_j, double rr, double int_tol)
+{
+	double mu = min_exp_i * min_exp_j / (min_exp_i + min_exp_j);
 
-					set_coef(con_j, sh_j->type, coef_j);
-					coef_j++;
-					if (sh_j->type == 'L')
-						coef_j++;
+	return mu * rr - log_coef_i - log_coef_j > int_tol;
+}
 
-					vec_t a = {
-						(ai*at_i->x + aj*at_j->x) * aa,
-						(ai*at_i->y + aj*at_j->y) * aa,
-						(ai*at_i->z + aj*at_j->z) * aa
-					};
+static void
+zero_block(size_t count_i, size_t count_j, size_t stride, double *out)
+{
+	for (size_t i = 0; i < count_i; i++)
+		memset(out + i * stride, 0, count_j * sizeof(double));
+}
 
-					double fac = exp(-tmp);
+/* One-dimensional overlap integrals over primitive Gaussians without the
+ * exp(-mu * r^2) factor by the Obara-Saika recurrence:
+ *
+ * S(i+1,j) = PA S(i,j) + (i S(i-1,j) + j S(i,j-1)) / 2p
+ * S(i,j+1) = PB S(i,j) + (i S(i-1,j) + j S(i,j-1)) / 2p */
+static void
+overlap_1d(size_t ni, size_t nj, double pa, double pb, double oo2p,
+    double s00, double out[OS_DIM_I][OS_DIM_J])
+{
+	out[0][0] = s00;
 
-					for (size_t i = start_i, idx = 0; i < end_i; i++)
-						for (size_t j = start_j; j < end_j; j++, idx++)
-							dij[idx] = fac * con_i[i] * int_norm[i] * con_j[j] * int_norm[j];
+	for (size_t j = 1; j < nj; j++) {
+		out[0][j] = pb * out[0][j - 1];
+		if (j > 1)
+			out[0][j] += (j - 1) * oo2p * out[0][j - 2];
+	}
+	for (size_t i = 1; i < ni; i++) {
+		out[i][0] = pa * out[i - 1][0];
+		if (i > 1)
+			out[i][0] += (i - 1) * oo2p * out[i - 2][0];
+
+		for (size_t j = 1; j < nj; j++) {
+			out[i][j] = pa * out[i - 1][j] +
+			    j * oo2p * out[i - 1][j - 1];
+			if (i > 1)
+				out[i][j] += (i - 1) * oo2p * out[i - 2][j];
+		}
+	}
+}
 
-					double taa = sqrt(aa);
-					double t1 = -2.0 * aj * aj * taa;
-					double t2 = -0.5 * taa;
-
-					for (size_t i = 0, idx = 0; i < sl_i; i++, idx += 5) {
-						for (size_t j = 0; j < sl_j; j++) {
-							vec_t iout;
-
-							make_int(i, j, taa, &a, CVEC(at_i->x), CVEC(at_j->x), &iout);
-							xin[idx + j] = iout.x * taa;
-							yin[idx + j] = iout.y * taa;
-							zin[idx + j] = iout.z * taa;
-
-							make_int(i, j + 2, taa, &a, CVEC(at_i->x), CVEC(at_j->x), &iout);
-							xin[idx + j + 30] = iout.x * t1;
-							yin[idx + j + 30] = iout.y * t1;
-							zin[idx + j + 30] = iout.z * t1;
-
-							if (j >= 2) {
-								make_int(i, j - 2, taa, &a, CVEC(at_i->x), CVEC(at_j->x), &iout);
-								double t3 = j * (j - 1) * t2;
-								xin[idx + j + 60] = iout.x * t3;
-								yin[idx + j + 60] = iout.y * t3;
-								zin[idx + j + 60] = iout.z * t3;
-							}
-							else {
-								xin[idx + j + 60] = 0.0;
-								yin[idx + j + 60] = 0.0;
-								zin[idx + j + 60] = 0.0;
-							}
-						}
-					}
-					for (size_t i = 0; i < count; i++) {
-						size_t nx = shift_x[i];
-						size_t ny = shift_y[i];
-						size_t nz = shift_z[i];
-						double xyz = xin[nx] * yin[ny] * zin[nz];
-						double add = (xin[nx + 30] + xin[nx + 60]) * yin[ny] * zin[nz] +
-							     (yin[ny + 30] + yin[ny + 60]) * xin[nx] * zin[nz] +
-							     (zin[nz + 30] + zin[nz + 60]) * xin[nx] * yin[ny];
-						sblk[i] = sblk[i] + dij[i] * xyz;
-						tblk[i] = tblk[i] + dij[i] * (xyz * aj * ft[i] + add);
-					}
-				}
-			}
+/* One-dimensional kinetic energy integrals from overlap integrals:
+ *
+ * T(i,j) = aj (2j+1) S(i,j) - 2 aj^2 S(i,j+2) - j (j-1) S(i,j-2) / 2 */
+static void
+kinetic_1d(size_t ni, size_t nj, double aj, double s[OS_DIM_I][OS_DIM_J],
+    double out[OS_DIM_I][OS_DIM_J])
+{
+	double aj2 = 2.0 * aj;
+
+	for (size_t i = 0; i < ni; i++) {
+		for (size_t j = 0; j < nj; j++) {
+			out[i][j] = (s[i][j] * (2 * j + 1) -
+			    s[i][j + 2] * aj2) * aj;
+			if (j > 1)
+				out[i][j] -= s[i][j - 2] * (j * (j - 1) / 2);
+		}
+	}
+}
 
-			/* store integrals */
-			for (size_t i = 0, idx = 0; i < count_i; i++) {
-				size_t idx2 = (loc_i + i) * stride + loc_j;
+/* Derivatives with respect to center i:
+ *
+ * dS(i,j) = 2 ai S(i+1,j) - i S(i-1,j) */
+static void
+deriv_1d(size_t ni, size_t nj, double ai, double s[OS_DIM_I][OS_DIM_J],
+    double out[OS_DIM_I][OS_DIM_J])
+{
+	double ai2 = 2.0 * ai;
 
-				for (size_t j = 0; j < count_j; j++, idx++, idx2++) {
-					s[idx2] = sblk[idx];
-					t[idx2] = tblk[idx];
-				}
-			}
-			loc_j += count_j;
-		}}
-		loc_i += count_i;
-	}}
+	for (size_t i = 0; i < ni; i++) {
+		for (size_t j = 0; j < nj; j++) {
+			out[i][j] = s[i + 1][j] * ai2;
+			if (i > 0)
+				out[i][j] -= s[i - 1][j] * i;
+		}
+	}
 }
 
-void
-efp_st_int_deriv(size_t n_atoms_i, const struct xr_atom *atoms_i,
-    size_t n_atoms_j, const struct xr_atom *atoms_j, const vec_t *com_i,
-    size_t size_i, size_t size_j, six_t *ds, six_t *dt)
+/* Overlap and kinetic energy integrals and their derivatives are computed
+ * from the same one-dimensional recurrence tables. Integrals are stored if
+ * s is not NULL and derivatives are accumulated if ds is not NULL. */
+static void
+st_int(size_t n_atoms_i, const struct xr_atom *atoms_i, size_t n_atoms_j,
+    const struct xr_atom *atoms_j, const vec_t *com_i, size_t stride,
+    double tol, double *s, double *t, six_t *ds, six_t *dt)
 {
-	static const size_t shift_x[] = { 0, 1, 0, 0, 2, 0, 0, 1, 1, 0,
-					  3, 0, 0, 2, 2, 1, 0, 1, 0, 1 };
-	static const size_t shift_y[] = { 0, 0, 1, 0, 0, 2, 0, 1, 0, 1,
-					  0, 3, 0, 1, 0, 2, 2, 0, 1, 1 };
-	static const size_t shift_z[] = { 0, 0, 0, 1, 0, 0, 2, 0, 1, 1,
-					  0, 0, 3, 0, 1, 0, 1, 2, 2, 1 };
 	double dij[100];
-	double xs[5][6], ys[5][6], zs[5][6];
-	double xt[5][4], yt[5][4], zt[5][4];
-	double dxs[4][4], dys[4][4], dzs[4][4];
-	double dxt[4][4], dyt[4][4], dzt[4][4];
-
-	memset(ds, 0, size_i * size_j * sizeof(six_t));
-	memset(dt, 0, size_i * size_j * sizeof(six_t));
+	double xs[OS_DIM_I][OS_DIM_J], ys[OS_DIM_I][OS_DIM_J];
+	double zs[OS_DIM_I][OS_DIM_J];
+	double xt[OS_DIM_I][OS_DIM_J], yt[OS_DIM_I][OS_DIM_J];
+	double zt[OS_DIM_I][OS_DIM_J];
+	double dxs[OS_DIM_I][OS_DIM_J], dys[OS_DIM_I][OS_DIM_J];
+	double dzs[OS_DIM_I][OS_DIM_J];
+	double dxt[OS_DIM_I][OS_DIM_J], dyt[OS_DIM_I][OS_DIM_J];
+	double dzt[OS_DIM_I][OS_DIM_J];
+	double int_tol = -log(tol);
+	double sqrt_pi = sqrt(PI);
 
 	for (size_t iii = 0, loc_i = 0; iii < n_atoms_i; iii++) {
 		const struct xr_atom *at_i = atoms_i + iii;
@@ -462,6 +282,10 @@ efp_st_int_deriv(size_t n_atoms_i, const struct xr_atom *atoms_i,
 
 		for (size_t jjj = 0, loc_j = 0; jjj < n_atoms_j; jjj++) {
 			const struct xr_atom *at_j = atoms_j + jjj;
+			double rr = vec_dist_2(CVEC(at_i->x), CVEC(at_j->x));
+			int skip_atom = screen_pair(sh_i->min_exp,
+			    sh_i->log_coef, at_j->min_exp, at_j->log_coef,
+			    rr, int_tol);
 
 		/* shell j */
 		for (size_t jj = 0; jj < at_j->n_shells; jj++) {
@@ -471,8 +295,23 @@ efp_st_int_deriv(size_t n_atoms_i, const struct xr_atom *atoms_i,
 			size_t end_j = get_shell_end(type_j);
 			size_t sl_j = get_shell_sl(type_j);
 			size_t count_j = end_j - start_j;
+			size_t loc = loc_i * stride + loc_j;
+
+			if (s) {
+				zero_block(count_i, count_j, stride, s + loc);
+				zero_block(count_i, count_j, stride, t + loc);
+			}
+
+			if (skip_atom || screen_pair(sh_i->min_exp,
+			    sh_i->log_coef, sh_j->min_exp, sh_j->log_coef,
+			    rr, int_tol)) {
+				loc_j += count_j;
+				continue;
+			}
+
+			/* derivatives need one more power on center i */
+			size_t ni = ds ? sl_i + 1 : sl_i;
 			const double *coef_i = sh_i->coef;
-			double rr = vec_dist_2(CVEC(at_i->x), CVEC(at_j->x));
 
 			/* primitive i */
 			for (size_t ig = 0; ig < sh_i->n_funcs; ig++) {
@@ -496,7 +335,6 @@ efp_st_int_deriv(size_t n_atoms_i, const struct xr_atom *atoms_i,
 						coef_j++;
 						if (sh_j->type == 'L')
 							coef_j++;
-
 						continue;
 					}
 
@@ -511,82 +349,67 @@ efp_st_int_deriv(size_t n_atoms_i, const struct xr_atom *atoms_i,
 						for (size_t j = start_j; j < end_j; j++, idx++)
 							dij[idx] = fac * con_i[i] * int_norm[i] * con_j[j] * int_norm[j];
 
-					double taa = sqrt(aa);
-
 					vec_t a = {
 						(ai * at_i->x + aj * at_j->x) * aa,
 						(ai * at_i->y + aj * at_j->y) * aa,
 						(ai * at_i->z + aj * at_j->z) * aa
 					};
 
-					for (size_t i = 0; i < sl_i + 1; i++) {
-						for (size_t j = 0; j < sl_j + 2; j++) {
-							vec_t iout;
-							make_int(i, j, taa, &a, CVEC(at_i->x), CVEC(at_j->x), &iout);
-							xs[i][j] = iout.x * taa;
-							ys[i][j] = iout.y * taa;
-							zs[i][j] = iout.z * taa;
-						}
-					}
+					double oo2p = 0.5 * aa;
+					double s00 = sqrt_pi * sqrt(aa);
 
-					double ai2 = 2.0 * ai;
-					double aj2 = 2.0 * aj;
+					overlap_1d(ni, sl_j + 2, a.x - at_i->x, a.x - at_j->x, oo2p, s00, xs);
+					overlap_1d(ni, sl_j + 2, a.y - at_i->y, a.y - at_j->y, oo2p, s00, ys);
+					overlap_1d(ni, sl_j + 2, a.z - at_i->z, a.z - at_j->z, oo2p, s00, zs);
 
-					for (size_t i = 0; i < sl_i + 1; i++) {
-						xt[i][0] = (xs[i][0] - xs[i][2] * aj2) * aj;
-						yt[i][0] = (ys[i][0] - ys[i][2] * aj2) * aj;
-						zt[i][0] = (zs[i][0] - zs[i][2] * aj2) * aj;
-					}
+					kinetic_1d(ni, sl_j, aj, xs, xt);
+					kinetic_1d(ni, sl_j, aj, ys, yt);
+					kinetic_1d(ni, sl_j, aj, zs, zt);
 
-					if (sl_j > 1) {
-						for (size_t i = 0; i < sl_i + 1; i++) {
-							xt[i][1] = (xs[i][1] * 3.0 - xs[i][3] * aj2) * aj;
-							yt[i][1] = (ys[i][1] * 3.0 - ys[i][3] * aj2) * aj;
-							zt[i][1] = (zs[i][1] * 3.0 - zs[i][3] * aj2) * aj;
-						}
+					if (s) {
+						for (size_t i = start_i, idx = 0; i < end_i; i++) {
+							size_t ix = func_x[i];
+							size_t iy = func_y[i];
+							size_t iz = func_z[i];
+							size_t idx2 = loc + (i - start_i) * stride;
+
+							for (size_t j = start_j; j < end_j; j++, idx++, idx2++) {
+								size_t jx = func_x[j];
+								size_t jy = func_y[j];
+								size_t jz = func_z[j];
 
-						for (size_t j = 2; j < sl_j; j++) {
-							for (size_t i = 0; i < sl_i + 1; i++) {
-								size_t n1 = 2 * j + 1;
-								size_t n2 = j * (j - 1) / 2;
-								xt[i][j] = (xs[i][j] * n1 - xs[i][j + 2] * aj2) * aj - xs[i][j - 2] * n2;
-								yt[i][j] = (ys[i][j] * n1 - ys[i][j + 2] * aj2) * aj - ys[i][j - 2] * n2;
-								zt[i][j] = (zs[i][j] * n1 - zs[i][j + 2] * aj2) * aj - zs[i][j - 2] * n2;
+								double xyz = xs[ix][jx] * ys[iy][jy] * zs[iz][jz];
+								double kin = xt[ix][jx] * ys[iy][jy] * zs[iz][jz] +
+									     xs[ix][jx] * yt[iy][jy] * zs[iz][jz] +
+									     xs[ix][jx] * ys[iy][jy] * zt[iz][jz];
+
+								s[idx2] += xyz * dij[idx];
+								t[idx2] += kin * dij[idx];
 							}
 						}
 					}
 
-					for (size_t j = 0; j < sl_j; j++) {
-						dxs[0][j] = xs[1][j] * ai2;
-						dys[0][j] = ys[1][j] * ai2;
-						dzs[0][j] = zs[1][j] * ai2;
-
-						dxt[0][j] = xt[1][j] * ai2;
-						dyt[0][j] = yt[1][j] * ai2;
-						dzt[0][j] = zt[1][j] * ai2;
-					}
+					if (!ds)
+						continue;
 
-					for (size_t i = 1; i < sl_i; i++) {
-						for (size_t j = 0; j < sl_j; j++) {
-							dxs[i][j] = xs[i + 1][j] * ai2 - xs[i - 1][j] * i;
-							dys[i][j] = ys[i + 1][j] * ai2 - ys[i - 1][j] * i;
-							dzs[i][j] = zs[i + 1][j] * ai2 - zs[i - 1][j] * i;
+					deriv_1d(sl_i, sl_j, ai, xs, dxs);
+					deriv_1d(sl_i, sl_j, ai, ys, dys);
+					deriv_1d(sl_i, sl_j, ai, zs, dzs);
 
-							dxt[i][j] = xt[i + 1][j] * ai2 - xt[i - 1][j] * i;
-							dyt[i][j] = yt[i + 1][j] * ai2 - yt[i - 1][j] * i;
-							dzt[i][j] = zt[i + 1][j] * ai2 - zt[i - 1][j] * i;
-						}
-					}
+					deriv_1d(sl_i, sl_j, ai, xt, dxt);
+					deriv_1d(sl_i, sl_j, ai, yt, dyt);
+					deriv_1d(sl_i, sl_j, ai, zt, dzt);
 
 					for (size_t i = start_i, idx = 0; i < end_i; i++) {
-						size_t ix = shift_x[i];
-						size_t iy = shift_y[i];
-						size_t iz = shift_z[i];
+						size_t ix = func_x[i];
+						size_t iy = func_y[i];
+						size_t iz = func_z[i];
+						size_t idx2 = loc + (i - start_i) * stride;
 
-						for (size_t j = start_j; j < end_j; j++, idx++) {
-							size_t jx = shift_x[j];
-							size_t jy = shift_y[j];
-							size_t jz = shift_z[j];
+						for (size_t j = start_j; j < end_j; j++, idx++, idx2++) {
+							size_t jx = func_x[j];
+							size_t jy = func_y[j];
+							size_t jz = func_z[j];
 
 							double txs = dxs[ix][jx] * ys[iy][jy] * zs[iz][jz];
 							double tys = xs[ix][jx] * dys[iy][jy] * zs[iz][jz];
@@ -602,8 +425,6 @@ efp_st_int_deriv(size_t n_atoms_i, const struct xr_atom *atoms_i,
 								     xs[ix][jx] * yt[iy][jy] * dzs[iz][jz] +
 								     xs[ix][jx] * ys[iy][jy] * dzt[iz][jz];
 
-							size_t idx2 = (loc_i + i - start_i) * size_j + (loc_j + j - start_j);
-
 							ds[idx2].x += txs * dij[idx];
 							ds[idx2].y += tys * dij[idx];
 							ds[idx2].z += tzs * dij[idx];
@@ -626,3 +447,25 @@ efp_st_int_deriv(size_t n_atoms_i, const struct xr_atom *atoms_i,
 		loc_i += count_i;
 	}}
 }
+
+void
+efp_st_int(size_t n_atoms_i, const struct xr_atom *atoms_i, size_t n_atoms_j,
+    const struct xr_atom *atoms_j, size_t stride, double tol, double *s,
+    double *t)
+{
+	st_int(n_atoms_i, atoms_i, n_atoms_j, atoms_j, NULL, stride, tol,
+	    s, t, NULL, NULL);
+}
+
+void
+efp_st_int_deriv(size_t n_atoms_i, const struct xr_atom *atoms_i,
+    size_t n_atoms_j, const struct xr_atom *atoms_j, const vec_t *com_i,
+    size_t size_i, size_t size_j, double tol, double *s, double *t,
+    six_t *ds, six_t *dt)
+{
+	memset(ds, 0, size_i * size_j * sizeof(six_t));
+	memset(dt, 0, size_i * size_j * sizeof(six_t));
+
+	st_int(n_atoms_i, atoms_i, n_atoms_j, atoms_j, com_i, size_j, tol,
+	    s, t, ds, dt);
+}
@@ -33,6 +33,8 @@ struct shell {
 	char type;       /* shell type - S,L,P,D,F */
 	size_t n_funcs;  /* number of functions */
 	double *coef;    /* function coefficients */
+	double min_exp;  /* smallest primitive exponent */
+	double log_coef; /* log of largest contraction coefficient */
 };
 
 struct xr_atom {
@@ -40,13 +42,18 @@ struct xr_atom {
 	double znuc;
 	size_t n_shells;
 	struct shell *shells;
+	double min_exp;  /* smallest exponent of all shells */
+	double log_coef; /* largest log_coef of all shells */
 };
 
+void efp_set_shell_extents(struct xr_atom *);
+
 void efp_st_int(size_t n_atoms_i,
 		const struct xr_atom *atoms_i,
 		size_t n_atoms_j,
 		const struct xr_atom *atoms_j,
 		size_t stride,
+		double tol,
 		double *s,
 		double *t);
 
@@ -57,6 +64,9 @@ void efp_st_int_deriv(size_t n_atoms_i,
 		      const vec_t *com_i,
 		      size_t size_i,
 		      size_t size_j,
+		      double tol,
+		      double *s,
+		      double *t,
 		      six_t *ds,
 		      six_t *dt);
 
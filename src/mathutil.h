@@ -170,6 +170,38 @@ six_atomic_sub_abc(six_t *six, const vec_t *a)
 	vec_atomic_sub(((vec_t *)six) + 1, a);
 }
 
+static inline void
+six_add_xyz(six_t *six, const vec_t *a)
+{
+	six->x += a->x;
+	six->y += a->y;
+	six->z += a->z;
+}
+
+static inline void
+six_add_abc(six_t *six, const vec_t *a)
+{
+	six->a += a->x;
+	six->b += a->y;
+	six->c += a->z;
+}
+
+static inline void
+six_sub_xyz(six_t *six, const vec_t *a)
+{
+	six->x -= a->x;
+	six->y -= a->y;
+	six->z -= a->z;
+}
+
+static inline void
+six_sub_abc(six_t *six, const vec_t *a)
+{
+	six->a -= a->x;
+	six->b -= a->y;
+	six->c -= a->z;
+}
+
 static inline vec_t
 vec_add(const vec_t *a, const vec_t *b)
 {
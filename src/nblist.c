@@ -0,0 +1,529 @@
+/*-
+ * Copyright (c) 2012-2017 Ilya Kaliman
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+
+#include "private.h"
+
+/*
+ * Fragment neighbor lists.
+ *
+ * If interaction cutoff is enabled, fragment centers are sorted into a grid
+ * of cells which are not smaller than the cutoff distance. Only fragments from
+ * the same or adjacent cells can interact, so the lists are built in linear
+ * time. Periodic boundary conditions use the same minimum image convention as
+ * efp_make_swf. Without cutoff all fragments are neighbors of each other and
+ * no lists are stored.
+ *
+ * If Verlet skin is specified, lists also include fragments which are not
+ * farther than cutoff plus skin distance. Such lists stay valid until some
+ * fragment moves by more than half of the skin, so they can be reused for
+ * many MD steps. Interacting pairs are still checked against the actual
+ * cutoff using efp_skip_frag_pair.
+ *
+ * Two-body terms are computed once per pair. Each pair is owned by one of
+ * its fragments and all owned pairs form a flat list ordered by the first
+ * fragment, so that work can be split into chunks of pairs rather than
+ * whole fragments. Without cutoff the list is implicit.
+ */
+
+struct cell_grid {
+	/* number of cells along each axis */
+	size_t n[3];
+
+	/* cell size along each axis */
+	double size[3];
+
+	/* lower corner of the grid */
+	double origin[3];
+
+	/* offsets into frags array for each cell, size n_cells + 1 */
+	size_t *start;
+
+	/* fragment indices sorted by cell */
+	size_t *frags;
+};
+
+static int
+cmp_size_t(const void *a, const void *b)
+{
+	size_t x = *(const size_t *)a;
+	size_t y = *(const size_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void
+setup_grid(const struct efp *efp, struct cell_grid *grid, double cutoff)
+{
+	double extent[3];
+	size_t max_cells = 8 * efp->n_frag + 27;
+
+	if (efp->opts.enable_pbc) {
+		extent[0] = efp->box.x;
+		extent[1] = efp->box.y;
+		extent[2] = efp->box.z;
+
+		for (size_t a = 0; a < 3; a++)
+			grid->origin[a] = 0.0;
+	} else {
+		double lo[3], hi[3];
+
+		for (size_t a = 0; a < 3; a++)
+			lo[a] = hi[a] = efp->n_frag > 0 ?
+			    (&efp->frags[0].x)[a] : 0.0;
+
+		for (size_t i = 1; i < efp->n_frag; i++) {
+			const double *xyz = &efp->frags[i].x;
+
+			for (size_t a = 0; a < 3; a++) {
+				if (xyz[a] < lo[a])
+					lo[a] = xyz[a];
+				if (xyz[a] > hi[a])
+					hi[a] = xyz[a];
+			}
+		}
+
+		for (size_t a = 0; a < 3; a++) {
+			grid->origin[a] = lo[a];
+			extent[a] = hi[a] - lo[a];
+		}
+	}
+
+	for (size_t a = 0; a < 3; a++) {
+		grid->n[a] = (size_t)(extent[a] / cutoff);
+
+		if (grid->n[a] < 1)
+			grid->n[a] = 1;
+	}
+
+	/* keep the grid small for sparse systems */
+	while (grid->n[0] * grid->n[1] * grid->n[2] > max_cells) {
+		size_t a = 0;
+
+		if (grid->n[1] > grid->n[a])
+			a = 1;
+		if (grid->n[2] > grid->n[a])
+			a = 2;
+
+		grid->n[a] /= 2;
+	}
+
+	for (size_t a = 0; a < 3; a++) {
+		grid->size[a] = extent[a] / grid->n[a];
+
+		if (grid->size[a] < cutoff)
+			grid->size[a] = cutoff;
+	}
+}
+
+static void
+get_cell(const struct efp *efp, const struct cell_grid *grid,
+    const struct frag *frag, size_t cell[3])
+{
+	const double *xyz = &frag->x;
+	const double *box = &efp->box.x;
+
+	for (size_t a = 0; a < 3; a++) {
+		double x = xyz[a] - grid->origin[a];
+
+		if (efp->opts.enable_pbc)
+			x -= box[a] * floor(x / box[a]);
+
+		if (x < 0.0)
+			x = 0.0;
+
+		cell[a] = (size_t)(x / grid->size[a]);
+
+		if (cell[a] >= grid->n[a])
+			cell[a] = grid->n[a] - 1;
+	}
+}
+
+static size_t
+get_cell_idx(const struct cell_grid *grid, const size_t cell[3])
+{
+	return (cell[0] * grid->n[1] + cell[1]) * grid->n[2] + cell[2];
+}
+
+/* unique cells adjacent to the cell c along one axis */
+static size_t
+get_stencil(const struct efp *efp, size_t n, size_t c, size_t out[3])
+{
+	size_t cnt = 0;
+
+	if (efp->opts.enable_pbc) {
+		out[cnt++] = c;
+
+		if (n > 1)
+			out[cnt++] = (c + 1) % n;
+		if (n > 2)
+			out[cnt++] = (c + n - 1) % n;
+	} else {
+		out[cnt++] = c;
+
+		if (c + 1 < n)
+			out[cnt++] = c + 1;
+		if (c > 0)
+			out[cnt++] = c - 1;
+	}
+	return cnt;
+}
+
+static int
+is_neighbor(const struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
+    double cutoff2)
+{
+	const struct frag *fr_i = efp->frags + fr_i_idx;
+	const struct frag *fr_j = efp->frags + fr_j_idx;
+
+	vec_t dr = vec_sub(CVEC(fr_j->x), CVEC(fr_i->x));
+
+	if (efp->opts.enable_pbc) {
+		vec_t cell = { efp->box.x * round(dr.x / efp->box.x),
+			       efp->box.y * round(dr.y / efp->box.y),
+			       efp->box.z * round(dr.z / efp->box.z) };
+		dr = vec_sub(&dr, &cell);
+	}
+	return vec_len_2(&dr) <= cutoff2;
+}
+
+/* stores neighbors of fragment if out is not NULL and returns their count */
+static size_t
+find_neighbors(const struct efp *efp, const struct cell_grid *grid,
+    size_t frag_idx, double cutoff2, size_t *out)
+{
+	size_t cell[3], stencil[3][3], n_stencil[3], cnt = 0;
+
+	get_cell(efp, grid, efp->frags + frag_idx, cell);
+
+	for (size_t a = 0; a < 3; a++)
+		n_stencil[a] = get_stencil(efp, grid->n[a], cell[a],
+		    stencil[a]);
+
+	for (size_t a = 0; a < n_stencil[0]; a++)
+	for (size_t b = 0; b < n_stencil[1]; b++)
+	for (size_t c = 0; c < n_stencil[2]; c++) {
+		size_t nb_cell[3] = { stencil[0][a], stencil[1][b],
+		    stencil[2][c] };
+		size_t idx = get_cell_idx(grid, nb_cell);
+
+		for (size_t k = grid->start[idx]; k < grid->start[idx + 1];
+		    k++) {
+			size_t j = grid->frags[k];
+
+			if (j == frag_idx ||
+			    !is_neighbor(efp, frag_idx, j, cutoff2))
+				continue;
+			if (out)
+				out[cnt] = j;
+			cnt++;
+		}
+	}
+	return cnt;
+}
+
+static enum efp_result
+build_nblist(struct efp *efp)
+{
+	struct cell_grid grid;
+	size_t n_cells, *frag_cell = NULL;
+	double cutoff = efp->opts.swf_cutoff + efp->opts.verlet_skin;
+	double cutoff2 = cutoff * cutoff;
+	enum efp_result res = EFP_RESULT_NO_MEMORY;
+
+	setup_grid(efp, &grid, cutoff);
+	n_cells = grid.n[0] * grid.n[1] * grid.n[2];
+
+	grid.start = (size_t *)calloc(n_cells + 1, sizeof(size_t));
+	grid.frags = (size_t *)malloc((efp->n_frag + 1) * sizeof(size_t));
+	frag_cell = (size_t *)malloc((efp->n_frag + 1) * sizeof(size_t));
+
+	if (grid.start == NULL || grid.frags == NULL || frag_cell == NULL)
+		goto error;
+
+	/* counting sort of fragments by cell */
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		size_t cell[3];
+
+		get_cell(efp, &grid, efp->frags + i, cell);
+		frag_cell[i] = get_cell_idx(&grid, cell);
+		grid.start[frag_cell[i] + 1]++;
+	}
+	for (size_t i = 0; i < n_cells; i++)
+		grid.start[i + 1] += grid.start[i];
+	for (size_t i = 0; i < efp->n_frag; i++)
+		grid.frags[grid.start[frag_cell[i]]++] = i;
+	for (size_t i = n_cells; i > 0; i--)
+		grid.start[i] = grid.start[i - 1];
+	grid.start[0] = 0;
+
+	size_t *offset = efp->nb_offset;
+
+	offset[0] = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (size_t i = 0; i < efp->n_frag; i++)
+		offset[i + 1] = find_neighbors(efp, &grid, i, cutoff2, NULL);
+
+	for (size_t i = 0; i < efp->n_frag; i++)
+		offset[i + 1] += offset[i];
+
+	if (offset[efp->n_frag] > efp->nb_size) {
+		size_t *nb;
+
+		nb = (size_t *)realloc(efp->nb_frags,
+		    offset[efp->n_frag] * sizeof(size_t));
+		if (nb == NULL)
+			goto error;
+
+		efp->nb_frags = nb;
+		efp->nb_size = offset[efp->n_frag];
+	}
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		size_t *nb = efp->nb_frags + offset[i];
+		size_t cnt = find_neighbors(efp, &grid, i, cutoff2, nb);
+
+		/* same order as in all-pairs loops */
+		qsort(nb, cnt, sizeof(size_t), cmp_size_t);
+	}
+
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		efp->nb_xyz[i].x = efp->frags[i].x;
+		efp->nb_xyz[i].y = efp->frags[i].y;
+		efp->nb_xyz[i].z = efp->frags[i].z;
+	}
+	res = EFP_RESULT_SUCCESS;
+error:
+	free(grid.start);
+	free(grid.frags);
+	free(frag_cell);
+	return res;
+}
+
+/* each pair of fragments is computed once by one of the two fragments chosen
+ * so that all fragments get about the same number of pairs */
+static size_t
+get_owned_count(size_t n_frag, size_t frag_idx)
+{
+	if (n_frag % 2)
+		return (n_frag - 1) / 2;
+
+	return frag_idx < n_frag / 2 ? n_frag / 2 : n_frag / 2 - 1;
+}
+
+int
+efp_is_pair_owner(const struct efp *efp, size_t fr_i_idx, size_t fr_j_idx)
+{
+	size_t n = efp->n_frag;
+
+	return (fr_j_idx + n - fr_i_idx) % n <= get_owned_count(n, fr_i_idx);
+}
+
+static enum efp_result
+build_pairs(struct efp *efp)
+{
+	size_t *offset = efp->pair_offset;
+
+	offset[0] = 0;
+
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		size_t n_nb = efp_get_nb_count(efp, i);
+		size_t cnt = 0;
+
+		for (size_t k = 0; k < n_nb; k++)
+			if (efp_is_pair_owner(efp, i, efp_get_nb(efp, i, k)))
+				cnt++;
+
+		offset[i + 1] = offset[i] + cnt;
+	}
+
+	if (offset[efp->n_frag] > efp->pair_size) {
+		size_t *pairs;
+
+		pairs = (size_t *)realloc(efp->pair_frags,
+		    offset[efp->n_frag] * sizeof(size_t));
+		if (pairs == NULL)
+			return EFP_RESULT_NO_MEMORY;
+
+		efp->pair_frags = pairs;
+		efp->pair_size = offset[efp->n_frag];
+	}
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		size_t n_nb = efp_get_nb_count(efp, i);
+		size_t idx = offset[i];
+
+		for (size_t k = 0; k < n_nb; k++) {
+			size_t j = efp_get_nb(efp, i, k);
+
+			if (efp_is_pair_owner(efp, i, j))
+				efp->pair_frags[idx++] = j;
+		}
+	}
+	return EFP_RESULT_SUCCESS;
+}
+
+enum efp_result
+efp_update_nblist(struct efp *efp)
+{
+	enum efp_result res;
+
+	if (!efp->opts.enable_cutoff || !efp->nb_stale)
+		return EFP_RESULT_SUCCESS;
+
+	if (efp->nb_offset == NULL) {
+		efp->nb_offset = (size_t *)calloc(efp->n_frag + 1,
+		    sizeof(size_t));
+		if (efp->nb_offset == NULL)
+			return EFP_RESULT_NO_MEMORY;
+	}
+	if (efp->pair_offset == NULL) {
+		efp->pair_offset = (size_t *)calloc(efp->n_frag + 1,
+		    sizeof(size_t));
+		if (efp->pair_offset == NULL)
+			return EFP_RESULT_NO_MEMORY;
+	}
+	if (efp->nb_xyz == NULL) {
+		efp->nb_xyz = (vec_t *)calloc(efp->n_frag + 1, sizeof(vec_t));
+		if (efp->nb_xyz == NULL)
+			return EFP_RESULT_NO_MEMORY;
+	}
+	if ((res = build_nblist(efp)))
+		return res;
+	if ((res = build_pairs(efp)))
+		return res;
+
+	efp->nb_stale = 0;
+	efp->halo_stale = 1;
+	efp->pair_cache_valid = 0;
+	return EFP_RESULT_SUCCESS;
+}
+
+void
+efp_check_nblist(struct efp *efp, size_t frag_idx)
+{
+	const struct frag *frag = efp->frags + frag_idx;
+	double skin = efp->opts.verlet_skin;
+
+	if (efp->nb_stale)
+		return;
+	if (skin == 0.0 || efp->nb_xyz == NULL) {
+		efp->nb_stale = 1;
+		return;
+	}
+	if (vec_dist(CVEC(frag->x), efp->nb_xyz + frag_idx) > 0.5 * skin)
+		efp->nb_stale = 1;
+}
+
+size_t
+efp_get_nb_count(const struct efp *efp, size_t frag_idx)
+{
+	if (!efp->opts.enable_cutoff)
+		return efp->n_frag - 1;
+
+	return efp->nb_offset[frag_idx + 1] - efp->nb_offset[frag_idx];
+}
+
+size_t
+efp_get_nb(const struct efp *efp, size_t frag_idx, size_t k)
+{
+	if (!efp->opts.enable_cutoff)
+		return k < frag_idx ? k : k + 1;
+
+	return efp->nb_frags[efp->nb_offset[frag_idx] + k];
+}
+
+size_t
+efp_get_pair_offset(const struct efp *efp, size_t frag_idx)
+{
+	size_t n = efp->n_frag, half = n / 2;
+
+	if (efp->opts.enable_cutoff)
+		return efp->pair_offset[frag_idx];
+	if (n % 2)
+		return frag_idx * half;
+	if (frag_idx < half)
+		return frag_idx * half;
+
+	return half * half + (frag_idx - half) * (half - 1);
+}
+
+size_t
+efp_get_pair(const struct efp *efp, size_t frag_idx, size_t pair_idx)
+{
+	if (efp->opts.enable_cutoff)
+		return efp->pair_frags[pair_idx];
+
+	pair_idx -= efp_get_pair_offset(efp, frag_idx);
+	return (frag_idx + pair_idx + 1) % efp->n_frag;
+}
+
+size_t
+efp_find_pair_frag(const struct efp *efp, size_t pair_idx)
+{
+	size_t lo = 0, hi = efp->n_frag;
+
+	/* last fragment with offset not greater than pair_idx */
+	while (lo < hi) {
+		size_t mid = (lo + hi + 1) / 2;
+
+		if (efp_get_pair_offset(efp, mid) <= pair_idx)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+/* index of the pair in the flat list, fr_i_idx must be the owner */
+size_t
+efp_get_pair_idx(const struct efp *efp, size_t fr_i_idx, size_t fr_j_idx)
+{
+	size_t offset = efp_get_pair_offset(efp, fr_i_idx);
+	size_t n = efp->n_frag;
+	const size_t *row, *ptr;
+
+	if (!efp->opts.enable_cutoff)
+		return offset + (fr_j_idx + n - fr_i_idx) % n - 1;
+
+	row = efp->pair_frags + offset;
+	ptr = (const size_t *)bsearch(&fr_j_idx, row,
+	    efp_get_pair_offset(efp, fr_i_idx + 1) - offset, sizeof(size_t),
+	    cmp_size_t);
+	assert(ptr);
+
+	return (size_t)(ptr - efp->pair_frags);
+}
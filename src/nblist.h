@@ -0,0 +1,44 @@
+/*-
+ * Copyright (c) 2012-2017 Ilya Kaliman
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef LIBEFP_NBLIST_H
+#define LIBEFP_NBLIST_H
+
+#include <stddef.h>
+
+struct efp;
+
+enum efp_result efp_update_nblist(struct efp *);
+void efp_check_nblist(struct efp *, size_t);
+size_t efp_get_nb_count(const struct efp *, size_t);
+size_t efp_get_nb(const struct efp *, size_t, size_t);
+size_t efp_get_pair_offset(const struct efp *, size_t);
+size_t efp_get_pair(const struct efp *, size_t, size_t);
+size_t efp_find_pair_frag(const struct efp *, size_t);
+int efp_is_pair_owner(const struct efp *, size_t, size_t);
+size_t efp_get_pair_idx(const struct efp *, size_t, size_t);
+
+#endif /* LIBEFP_NBLIST_H */
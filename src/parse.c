@@ -498,6 +498,7 @@ shell:
 
 			efp_stream_next_line(stream);
 		}
+		efp_set_shell_extents(atom);
 		goto shell;
 	}
 
@@ -888,6 +889,7 @@ parse_file(struct efp *efp, struct stream *stream)
 		}
 
 		frag->lib = frag;
+		frag->lib_idx = efp->n_lib - 1;
 		strcpy(frag->name, name);
 		efp->lib[efp->n_lib - 1] = frag;
 
@@ -32,6 +32,7 @@
 
 #define POL_SCF_TOL 1.0e-10
 #define POL_SCF_MAX_ITER 80
+#define POL_OPT_ORDER 3
 
 double efp_get_pol_damp_tt(double, double, double);
 enum efp_result efp_compute_id_direct(struct efp *);
@@ -42,6 +43,13 @@ struct id_work_data {
 	vec_t *id_conj_new;
 };
 
+struct field_work_data {
+	const vec_t *dip;
+	const vec_t *dip_conj;
+	vec_t *field;
+	vec_t *field_conj;
+};
+
 double
 efp_get_pol_damp_tt(double r, double pa, double pb)
 {
@@ -113,28 +121,36 @@ get_multipole_field(const vec_t *xyz, const struct multipole_pt *mult_pt,
 	return field;
 }
 
-static vec_t
-get_elec_field(const struct efp *efp, size_t frag_idx, size_t pt_idx)
+/* turns switching function data of pair i-j into data of pair j-i */
+static void
+reverse_swf(struct swf *swf)
 {
-	const struct frag *fr_j = efp->frags + frag_idx;
-	const struct polarizable_pt *pt = fr_j->polarizable_pts + pt_idx;
-	vec_t elec_field = vec_zero;
+	vec_negate(&swf->dr);
+	vec_negate(&swf->cell);
+	vec_negate(&swf->dswf);
+}
 
-	for (size_t i = 0; i < efp->n_frag; i++) {
-		if (i == frag_idx || efp_skip_frag_pair(efp, i, frag_idx))
-			continue;
+/* adds field due to nuclei and multipoles of fragment i on polarizable points
+ * of fragment j */
+static void
+add_frag_field(const struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
+    const struct swf *swf, vec_t *field)
+{
+	const struct frag *fr_i = efp->frags + fr_i_idx;
+	const struct frag *fr_j = efp->frags + fr_j_idx;
 
-		const struct frag *fr_i = efp->frags + i;
-		struct swf swf = efp_make_swf(efp, fr_i, fr_j);
+	for (size_t k = 0; k < fr_j->n_polarizable_pts; k++) {
+		const struct polarizable_pt *pt = fr_j->polarizable_pts + k;
+		vec_t elec_field = vec_zero;
 
 		/* field due to nuclei */
 		for (size_t j = 0; j < fr_i->n_atoms; j++) {
 			const struct efp_atom *at = fr_i->atoms + j;
 
 			vec_t dr = {
-				pt->x - at->x - swf.cell.x,
-				pt->y - at->y - swf.cell.y,
-				pt->z - at->z - swf.cell.z
+				pt->x - at->x - swf->cell.x,
+				pt->y - at->y - swf->cell.y,
+				pt->z - at->z - swf->cell.z
 			};
 
 			double r = vec_len(&dr);
@@ -145,9 +161,9 @@ get_elec_field(const struct efp *efp, size_t frag_idx, size_t pt_idx)
 				p1 = efp_get_pol_damp_tt(r, fr_i->pol_damp,
 				    fr_j->pol_damp);
 			}
-			elec_field.x += swf.swf * at->znuc * dr.x / r3 * p1;
-			elec_field.y += swf.swf * at->znuc * dr.y / r3 * p1;
-			elec_field.z += swf.swf * at->znuc * dr.z / r3 * p1;
+			elec_field.x += swf->swf * at->znuc * dr.x / r3 * p1;
+			elec_field.y += swf->swf * at->znuc * dr.y / r3 * p1;
+			elec_field.z += swf->swf * at->znuc * dr.z / r3 * p1;
 		}
 
 		/* field due to multipoles */
@@ -155,12 +171,12 @@ get_elec_field(const struct efp *efp, size_t frag_idx, size_t pt_idx)
 			const struct multipole_pt *mult_pt =
 			    fr_i->multipole_pts + j;
 			vec_t mult_field = get_multipole_field(CVEC(pt->x),
-			    mult_pt, &swf);
+			    mult_pt, swf);
 
 			vec_t dr = {
-				pt->x - mult_pt->x - swf.cell.x,
-				pt->y - mult_pt->y - swf.cell.y,
-				pt->z - mult_pt->z - swf.cell.z
+				pt->x - mult_pt->x - swf->cell.x,
+				pt->y - mult_pt->y - swf->cell.y,
+				pt->z - mult_pt->z - swf->cell.z
 			};
 
 			double r = vec_len(&dr);
@@ -174,23 +190,34 @@ get_elec_field(const struct efp *efp, size_t frag_idx, size_t pt_idx)
 			elec_field.y += mult_field.y * p1;
 			elec_field.z += mult_field.z * p1;
 		}
+
+		field[fr_j->polarizable_offset + k] = vec_add(
+		    field + fr_j->polarizable_offset + k, &elec_field);
 	}
+}
+
+/* adds field due to nuclei from ab initio subsystem on polarizable points of
+ * a fragment */
+static void
+add_ai_field(const struct efp *efp, size_t frag_idx, vec_t *field)
+{
+	const struct frag *frag = efp->frags + frag_idx;
+
+	for (size_t k = 0; k < frag->n_polarizable_pts; k++) {
+		const struct polarizable_pt *pt = frag->polarizable_pts + k;
+		vec_t *elec_field = field + frag->polarizable_offset + k;
 
-	if (efp->opts.terms & EFP_TERM_AI_POL) {
-		/* field due to nuclei from ab initio subsystem */
 		for (size_t i = 0; i < efp->n_ptc; i++) {
 			vec_t dr = vec_sub(CVEC(pt->x), efp->ptc_xyz + i);
 
 			double r = vec_len(&dr);
 			double r3 = r * r * r;
 
-			elec_field.x += efp->ptc[i] * dr.x / r3;
-			elec_field.y += efp->ptc[i] * dr.y / r3;
-			elec_field.z += efp->ptc[i] * dr.z / r3;
+			elec_field->x += efp->ptc[i] * dr.x / r3;
+			elec_field->y += efp->ptc[i] * dr.y / r3;
+			elec_field->z += efp->ptc[i] * dr.z / r3;
 		}
 	}
-
-	return elec_field;
 }
 
 static enum efp_result
@@ -236,21 +263,78 @@ error:
 	return res;
 }
 
+/* Each owned pair of fragments is visited once and contributes field in both
+ * directions. Both ends of a pair are updated, so every thread accumulates
+ * field in its own workspace buffer. */
 static void
 compute_elec_field_range(struct efp *efp, size_t from, size_t to, void *data)
 {
-	vec_t *elec_field = (vec_t *)data;
+	(void)data;
 
 #ifdef _OPENMP
 #pragma omp parallel for schedule(dynamic)
 #endif
 	for (size_t i = from; i < to; i++) {
-		const struct frag *frag = efp->frags + i;
+		struct workspace *ws = efp_get_workspace(efp);
+		size_t pair_from = efp_get_pair_offset(efp, i);
+		size_t pair_to = efp_get_pair_offset(efp, i + 1);
 
-		for (size_t j = 0; j < frag->n_polarizable_pts; j++) {
-			elec_field[frag->polarizable_offset + j] =
-			    get_elec_field(efp, i, j);
+		for (size_t p = pair_from; p < pair_to; p++) {
+			size_t j = efp_get_pair(efp, i, p);
+
+			if (efp_skip_frag_pair(efp, i, j))
+				continue;
+
+			struct swf swf = efp_make_swf(efp, efp->frags + i,
+			    efp->frags + j);
+
+			add_frag_field(efp, i, j, &swf, ws->field);
+
+			reverse_swf(&swf);
+			add_frag_field(efp, j, i, &swf, ws->field);
 		}
+
+		if (efp->opts.terms & EFP_TERM_AI_POL)
+			add_ai_field(efp, i, ws->field);
+	}
+}
+
+/* In distributed polarization each process needs field only on points of
+ * fragments it owns. Pairs with fragments of other processes contribute
+ * only to the owned end, so no reduction between processes is needed. */
+static void
+compute_elec_field_owned(struct efp *efp)
+{
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (size_t k = 0; k < efp->n_own_frags; k++) {
+		struct workspace *ws = efp_get_workspace(efp);
+		size_t i = efp->own_frags[k];
+		size_t n_nb = efp_get_nb_count(efp, i);
+
+		for (size_t nb = 0; nb < n_nb; nb++) {
+			size_t j = efp_get_nb(efp, i, nb);
+			int owned = efp->frag_owner[j] == efp->frag_owner[i];
+
+			if (owned && !efp_is_pair_owner(efp, i, j))
+				continue;
+			if (efp_skip_frag_pair(efp, i, j))
+				continue;
+
+			struct swf swf = efp_make_swf(efp, efp->frags + j,
+			    efp->frags + i);
+
+			add_frag_field(efp, j, i, &swf, ws->field);
+
+			if (owned) {
+				reverse_swf(&swf);
+				add_frag_field(efp, i, j, &swf, ws->field);
+			}
+		}
+
+		if (efp->opts.terms & EFP_TERM_AI_POL)
+			add_ai_field(efp, i, ws->field);
 	}
 }
 
@@ -261,8 +345,27 @@ compute_elec_field(struct efp *efp)
 	enum efp_result res;
 
 	elec_field = (vec_t *)calloc(efp->n_polarizable_pts, sizeof(vec_t));
-	efp_balance_work(efp, compute_elec_field_range, elec_field);
-	efp_allreduce((double *)elec_field, 3 * efp->n_polarizable_pts);
+
+	if (efp->dist_pol)
+		compute_elec_field_owned(efp);
+	else
+		efp_balance_work(efp, compute_elec_field_range, NULL);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for (size_t i = 0; i < efp->n_polarizable_pts; i++) {
+		for (size_t k = 0; k < efp->n_ws; k++) {
+			vec_t *field = efp->ws[k].field + i;
+
+			elec_field[i] = vec_add(elec_field + i, field);
+			*field = vec_zero;
+		}
+	}
+
+	if (!efp->dist_pol)
+		efp_allreduce(efp, (double *)elec_field,
+		    3 * efp->n_polarizable_pts);
 
 #ifdef _OPENMP
 #pragma omp parallel for schedule(dynamic)
@@ -285,17 +388,192 @@ compute_elec_field(struct efp *efp)
 	return EFP_RESULT_SUCCESS;
 }
 
+/*
+ * Dipole field tensors do not change during solution of polarization
+ * equations. If interaction cutoff is enabled they are stored as a sparse
+ * matrix with one row per polarizable point and the induced dipole field is
+ * computed as a matrix-vector product. Rows of a fragment are computed when
+ * the fragment is first processed, so with MPI each process only fills rows
+ * of fragments it works on.
+ */
+static int
+use_dipole_tensors(const struct efp *efp)
+{
+	return efp->opts.enable_cutoff && !efp->opts.disable_pol_cache;
+}
+
+static enum efp_result
+setup_dipole_tensors(struct efp *efp)
+{
+	size_t *offset;
+
+	if (!use_dipole_tensors(efp))
+		return EFP_RESULT_SUCCESS;
+
+	if (efp->pol_offset == NULL) {
+		efp->pol_offset = (size_t *)calloc(efp->n_polarizable_pts + 1,
+		    sizeof(size_t));
+		if (efp->pol_offset == NULL)
+			return EFP_RESULT_NO_MEMORY;
+	}
+	if (efp->pol_built == NULL) {
+		efp->pol_built = (char *)calloc(efp->n_frag, 1);
+		if (efp->pol_built == NULL)
+			return EFP_RESULT_NO_MEMORY;
+	}
+
+	offset = efp->pol_offset;
+	offset[0] = 0;
+
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		const struct frag *frag = efp->frags + i;
+		size_t n_nb = efp_get_nb_count(efp, i);
+		size_t cnt = 0;
+
+		for (size_t k = 0; k < n_nb; k++) {
+			size_t j = efp_get_nb(efp, i, k);
+
+			if (!efp_skip_frag_pair(efp, i, j))
+				cnt += efp->frags[j].n_polarizable_pts;
+		}
+		for (size_t j = 0; j < frag->n_polarizable_pts; j++) {
+			size_t idx = frag->polarizable_offset + j;
+
+			offset[idx + 1] = offset[idx] + cnt;
+		}
+	}
+
+	if (offset[efp->n_polarizable_pts] > efp->pol_size) {
+		struct dipole_tensor *tensors;
+
+		tensors = (struct dipole_tensor *)realloc(efp->pol_tensors,
+		    offset[efp->n_polarizable_pts] *
+		    sizeof(struct dipole_tensor));
+		if (tensors == NULL)
+			return EFP_RESULT_NO_MEMORY;
+
+		efp->pol_tensors = tensors;
+		efp->pol_size = offset[efp->n_polarizable_pts];
+	}
+
+	memset(efp->pol_built, 0, efp->n_frag);
+	return EFP_RESULT_SUCCESS;
+}
+
 static void
-get_induced_dipole_field(struct efp *efp, size_t frag_idx,
-    struct polarizable_pt *pt, vec_t *field, vec_t *field_conj)
+build_dipole_tensors(struct efp *efp, size_t frag_idx)
 {
 	struct frag *fr_i = efp->frags + frag_idx;
+	size_t n_nb = efp_get_nb_count(efp, frag_idx);
+
+	for (size_t ii = 0; ii < fr_i->n_polarizable_pts; ii++) {
+		struct polarizable_pt *pt = fr_i->polarizable_pts + ii;
+		struct dipole_tensor *dt = efp->pol_tensors +
+		    efp->pol_offset[fr_i->polarizable_offset + ii];
+
+		for (size_t k = 0; k < n_nb; k++) {
+			size_t j = efp_get_nb(efp, frag_idx, k);
+
+			if (efp_skip_frag_pair(efp, frag_idx, j))
+				continue;
+
+			struct frag *fr_j = efp->frags + j;
+			struct swf swf = efp_make_swf(efp, fr_i, fr_j);
+
+			for (size_t jj = 0; jj < fr_j->n_polarizable_pts;
+			    jj++, dt++) {
+				struct polarizable_pt *pt_j =
+				    fr_j->polarizable_pts + jj;
+
+				vec_t dr = {
+					pt->x - pt_j->x + swf.cell.x,
+					pt->y - pt_j->y + swf.cell.y,
+					pt->z - pt_j->z + swf.cell.z
+				};
+
+				double r = vec_len(&dr);
+				double r3 = r * r * r;
+				double r5 = r3 * r * r;
+				double p1 = 1.0;
+
+				if (efp->opts.pol_damp == EFP_POL_DAMP_TT) {
+					p1 = efp_get_pol_damp_tt(r,
+					    fr_i->pol_damp, fr_j->pol_damp);
+				}
+
+				double a = -swf.swf * p1 / r3;
+				double b = 3.0 * swf.swf * p1 / r5;
+
+				dt->idx = fr_j->polarizable_offset + jj;
+				dt->xx = a + b * dr.x * dr.x;
+				dt->yy = a + b * dr.y * dr.y;
+				dt->zz = a + b * dr.z * dr.z;
+				dt->xy = b * dr.x * dr.y;
+				dt->xz = b * dr.x * dr.z;
+				dt->yz = b * dr.y * dr.z;
+			}
+		}
+	}
+	efp->pol_built[frag_idx] = 1;
+}
+
+static void
+get_stored_dipole_field(struct efp *efp, size_t frag_idx, size_t pt_idx,
+    const vec_t *dip, const vec_t *dip_conj, vec_t *field,
+    vec_t *field_conj)
+{
+	size_t idx = efp->frags[frag_idx].polarizable_offset + pt_idx;
+	const struct dipole_tensor *dt = efp->pol_tensors +
+	    efp->pol_offset[idx];
+	const struct dipole_tensor *end = efp->pol_tensors +
+	    efp->pol_offset[idx + 1];
+
+	if (!efp->pol_built[frag_idx])
+		build_dipole_tensors(efp, frag_idx);
 
 	*field = vec_zero;
 	*field_conj = vec_zero;
 
-	for (size_t j = 0; j < efp->n_frag; j++) {
-		if (j == frag_idx || efp_skip_frag_pair(efp, frag_idx, j))
+	for (; dt < end; dt++) {
+		const vec_t *m = dip + dt->idx;
+		const vec_t *mc = dip_conj + dt->idx;
+
+		field->x += dt->xx * m->x + dt->xy * m->y + dt->xz * m->z;
+		field->y += dt->xy * m->x + dt->yy * m->y + dt->yz * m->z;
+		field->z += dt->xz * m->x + dt->yz * m->y + dt->zz * m->z;
+
+		field_conj->x += dt->xx * mc->x + dt->xy * mc->y +
+		    dt->xz * mc->z;
+		field_conj->y += dt->xy * mc->x + dt->yy * mc->y +
+		    dt->yz * mc->z;
+		field_conj->z += dt->xz * mc->x + dt->yz * mc->y +
+		    dt->zz * mc->z;
+	}
+}
+
+static void
+get_induced_dipole_field(struct efp *efp, size_t frag_idx, size_t pt_idx,
+    const vec_t *dip, const vec_t *dip_conj, vec_t *field,
+    vec_t *field_conj)
+{
+	struct frag *fr_i = efp->frags + frag_idx;
+	struct polarizable_pt *pt = fr_i->polarizable_pts + pt_idx;
+
+	size_t n_nb = efp_get_nb_count(efp, frag_idx);
+
+	if (use_dipole_tensors(efp)) {
+		get_stored_dipole_field(efp, frag_idx, pt_idx, dip, dip_conj,
+		    field, field_conj);
+		return;
+	}
+
+	*field = vec_zero;
+	*field_conj = vec_zero;
+
+	for (size_t k = 0; k < n_nb; k++) {
+		size_t j = efp_get_nb(efp, frag_idx, k);
+
+		if (efp_skip_frag_pair(efp, frag_idx, j))
 			continue;
 
 		struct frag *fr_j = efp->frags + j;
@@ -315,8 +593,8 @@ get_induced_dipole_field(struct efp *efp, size_t frag_idx,
 			double r3 = r * r * r;
 			double r5 = r3 * r * r;
 
-			double t1 = vec_dot(&efp->indip[idx], &dr);
-			double t2 = vec_dot(&efp->indipconj[idx], &dr);
+			double t1 = vec_dot(&dip[idx], &dr);
+			double t2 = vec_dot(&dip_conj[idx], &dr);
 
 			double p1 = 1.0;
 
@@ -324,67 +602,108 @@ get_induced_dipole_field(struct efp *efp, size_t frag_idx,
 				p1 = efp_get_pol_damp_tt(r, fr_i->pol_damp,
 				    fr_j->pol_damp);
 			}
-			field->x -= swf.swf * p1 * (efp->indip[idx].x / r3 -
+			field->x -= swf.swf * p1 * (dip[idx].x / r3 -
 			    3.0 * t1 * dr.x / r5);
-			field->y -= swf.swf * p1 * (efp->indip[idx].y / r3 -
+			field->y -= swf.swf * p1 * (dip[idx].y / r3 -
 			    3.0 * t1 * dr.y / r5);
-			field->z -= swf.swf * p1 * (efp->indip[idx].z / r3 -
+			field->z -= swf.swf * p1 * (dip[idx].z / r3 -
 			    3.0 * t1 * dr.z / r5);
 
 			field_conj->x -= swf.swf * p1 *
-			    (efp->indipconj[idx].x / r3 - 3.0 * t2 * dr.x / r5);
+			    (dip_conj[idx].x / r3 - 3.0 * t2 * dr.x / r5);
 			field_conj->y -= swf.swf * p1 *
-			    (efp->indipconj[idx].y / r3 - 3.0 * t2 * dr.y / r5);
+			    (dip_conj[idx].y / r3 - 3.0 * t2 * dr.y / r5);
 			field_conj->z -= swf.swf * p1 *
-			    (efp->indipconj[idx].z / r3 - 3.0 * t2 * dr.z / r5);
+			    (dip_conj[idx].z / r3 - 3.0 * t2 * dr.z / r5);
 		}
 	}
 }
 
+/* computes new induced dipoles of a fragment from the current ones, returns
+ * sum of their changes */
+static double
+compute_id_frag(struct efp *efp, size_t frag_idx, vec_t *id_new,
+    vec_t *id_conj_new)
+{
+	struct frag *frag = efp->frags + frag_idx;
+	double conv = 0.0;
+
+	for (size_t j = 0; j < frag->n_polarizable_pts; j++) {
+		struct polarizable_pt *pt = frag->polarizable_pts + j;
+		size_t idx = frag->polarizable_offset + j;
+		vec_t field, field_conj;
+
+		/* electric field from other induced dipoles */
+		get_induced_dipole_field(efp, frag_idx, j, efp->indip,
+		    efp->indipconj, &field, &field_conj);
+
+		/* add field that doesn't change during scf */
+		field.x += pt->elec_field.x + pt->elec_field_wf.x;
+		field.y += pt->elec_field.y + pt->elec_field_wf.y;
+		field.z += pt->elec_field.z + pt->elec_field_wf.z;
+
+		field_conj.x += pt->elec_field.x + pt->elec_field_wf.x;
+		field_conj.y += pt->elec_field.y + pt->elec_field_wf.y;
+		field_conj.z += pt->elec_field.z + pt->elec_field_wf.z;
+
+		id_new[idx] = mat_vec(&pt->tensor, &field);
+		id_conj_new[idx] = mat_trans_vec(&pt->tensor, &field_conj);
+
+		conv += vec_dist(&id_new[idx], &efp->indip[idx]);
+		conv += vec_dist(&id_conj_new[idx], &efp->indipconj[idx]);
+	}
+	return conv;
+}
+
 static void
 compute_id_range(struct efp *efp, size_t from, size_t to, void *data)
 {
+	struct id_work_data *work = (struct id_work_data *)data;
 	double conv = 0.0;
-	vec_t *id_new, *id_conj_new;
-
-	id_new = ((struct id_work_data *)data)->id_new;
-	id_conj_new = ((struct id_work_data *)data)->id_conj_new;
 
 #ifdef _OPENMP
 #pragma omp parallel for schedule(dynamic) reduction(+:conv)
 #endif
-	for (size_t i = from; i < to; i++) {
-		struct frag *frag = efp->frags + i;
-
-		for (size_t j = 0; j < frag->n_polarizable_pts; j++) {
-			struct polarizable_pt *pt = frag->polarizable_pts + j;
-			size_t idx = frag->polarizable_offset + j;
-			vec_t field, field_conj;
-
-			/* electric field from other induced dipoles */
-			get_induced_dipole_field(efp, i, pt, &field,
-			    &field_conj);
+	for (size_t i = from; i < to; i++)
+		conv += compute_id_frag(efp, i, work->id_new,
+		    work->id_conj_new);
 
-			/* add field that doesn't change during scf */
-			field.x += pt->elec_field.x + pt->elec_field_wf.x;
-			field.y += pt->elec_field.y + pt->elec_field_wf.y;
-			field.z += pt->elec_field.z + pt->elec_field_wf.z;
+	work->conv += conv;
+}
 
-			field_conj.x += pt->elec_field.x + pt->elec_field_wf.x;
-			field_conj.y += pt->elec_field.y + pt->elec_field_wf.y;
-			field_conj.z += pt->elec_field.z + pt->elec_field_wf.z;
+/* Only induced dipoles of owned fragments are updated. New values are
+ * copied to the current arrays and sent to processes which own their
+ * neighbors, so only the convergence measure is reduced globally. */
+static double
+pol_scf_iter_owned(struct efp *efp, vec_t *id_new, vec_t *id_conj_new)
+{
+	double conv = 0.0;
 
-			id_new[idx] = mat_vec(&pt->tensor, &field);
-			id_conj_new[idx] = mat_trans_vec(&pt->tensor,
-			    &field_conj);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(+:conv)
+#endif
+	for (size_t k = 0; k < efp->n_own_frags; k++)
+		conv += compute_id_frag(efp, efp->own_frags[k], id_new,
+		    id_conj_new);
 
-			conv += vec_dist(&id_new[idx], &efp->indip[idx]);
-			conv += vec_dist(&id_conj_new[idx],
-			    &efp->indipconj[idx]);
-		}
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for (size_t k = 0; k < efp->n_own_frags; k++) {
+		const struct frag *frag = efp->frags + efp->own_frags[k];
+		size_t off = frag->polarizable_offset;
+		size_t n = frag->n_polarizable_pts;
+
+		memcpy(efp->indip + off, id_new + off, n * sizeof(vec_t));
+		memcpy(efp->indipconj + off, id_conj_new + off,
+		    n * sizeof(vec_t));
 	}
 
-	((struct id_work_data *)data)->conv += conv;
+	efp_exchange_halo(efp, (double *)efp->indip,
+	    (double *)efp->indipconj);
+	efp_allreduce(efp, &conv, 1);
+
+	return conv;
 }
 
 static double
@@ -397,14 +716,19 @@ pol_scf_iter(struct efp *efp)
 	data.id_new = (vec_t *)calloc(npts, sizeof(vec_t));
 	data.id_conj_new = (vec_t *)calloc(npts, sizeof(vec_t));
 
-	efp_balance_work(efp, compute_id_range, &data);
+	if (efp->dist_pol) {
+		data.conv = pol_scf_iter_owned(efp, data.id_new,
+		    data.id_conj_new);
+	} else {
+		efp_balance_work(efp, compute_id_range, &data);
 
-	efp_allreduce((double *)data.id_new, 3 * npts);
-	efp_allreduce((double *)data.id_conj_new, 3 * npts);
-	efp_allreduce(&data.conv, 1);
+		efp_allreduce(efp, (double *)data.id_new, 3 * npts);
+		efp_allreduce(efp, (double *)data.id_conj_new, 3 * npts);
+		efp_allreduce(efp, &data.conv, 1);
 
-	memcpy(efp->indip, data.id_new, npts * sizeof(vec_t));
-	memcpy(efp->indipconj, data.id_conj_new, npts * sizeof(vec_t));
+		memcpy(efp->indip, data.id_new, npts * sizeof(vec_t));
+		memcpy(efp->indipconj, data.id_conj_new, npts * sizeof(vec_t));
+	}
 
 	free(data.id_new);
 	free(data.id_conj_new);
@@ -412,6 +736,49 @@ pol_scf_iter(struct efp *efp)
 	return data.conv / npts / 2;
 }
 
+/* after distributed solution every process gets all induced dipoles */
+static void
+gather_induced_dipoles(struct efp *efp)
+{
+	size_t npts = efp->n_polarizable_pts;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		const struct frag *frag = efp->frags + i;
+		size_t off = frag->polarizable_offset;
+		size_t n = frag->n_polarizable_pts;
+
+		if (efp->frag_owner[i] == efp->halo.rank)
+			continue;
+
+		memset(efp->indip + off, 0, n * sizeof(vec_t));
+		memset(efp->indipconj + off, 0, n * sizeof(vec_t));
+	}
+
+	efp_allreduce(efp, (double *)efp->indip, 3 * npts);
+	efp_allreduce(efp, (double *)efp->indipconj, 3 * npts);
+}
+
+static double
+get_frag_energy(const struct efp *efp, size_t frag_idx)
+{
+	const struct frag *frag = efp->frags + frag_idx;
+	double energy = 0.0;
+
+	for (size_t j = 0; j < frag->n_polarizable_pts; j++) {
+		const struct polarizable_pt *pt = frag->polarizable_pts + j;
+		size_t idx = frag->polarizable_offset + j;
+
+		energy += 0.5 * vec_dot(&efp->indipconj[idx],
+					&pt->elec_field_wf) -
+			  0.5 * vec_dot(&efp->indip[idx],
+					&pt->elec_field);
+	}
+	return energy;
+}
+
 static void
 compute_energy_range(struct efp *efp, size_t from, size_t to, void *data)
 {
@@ -419,36 +786,394 @@ compute_energy_range(struct efp *efp, size_t from, size_t to, void *data)
 
 #ifdef _OPENMP
 #pragma omp parallel for schedule(dynamic) reduction(+:energy)
+#endif
+	for (size_t i = from; i < to; i++)
+		energy += get_frag_energy(efp, i);
+
+	*(double *)data += energy;
+}
+
+/* static field is known only on owned points in distributed polarization */
+static void
+compute_energy_owned(struct efp *efp, double *energy)
+{
+	double sum = 0.0;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(+:sum)
+#endif
+	for (size_t k = 0; k < efp->n_own_frags; k++)
+		sum += get_frag_energy(efp, efp->own_frags[k]);
+
+	*energy += sum;
+}
+
+static double
+get_pol_scf_tol(const struct efp *efp)
+{
+	if (efp->opts.pol_scf_tol > 0.0)
+		return efp->opts.pol_scf_tol;
+
+	return POL_SCF_TOL;
+}
+
+static size_t
+get_pol_scf_max_iter(const struct efp *efp)
+{
+	if (efp->opts.pol_scf_max_iter > 0)
+		return efp->opts.pol_scf_max_iter;
+
+	return POL_SCF_MAX_ITER;
+}
+
+static enum efp_result
+efp_compute_id_iterative(struct efp *efp)
+{
+	double tol = get_pol_scf_tol(efp);
+	size_t max_iter = get_pol_scf_max_iter(efp);
+
+	for (size_t iter = 1; iter <= max_iter; iter++) {
+		if (pol_scf_iter(efp) < tol)
+			break;
+		if (iter == max_iter && !efp->opts.disable_pol_conv_check)
+			return EFP_RESULT_POL_NOT_CONVERGED;
+	}
+	if (efp->dist_pol)
+		gather_induced_dipoles(efp);
+
+	return EFP_RESULT_SUCCESS;
+}
+
+static void
+compute_dipole_field_range(struct efp *efp, size_t from, size_t to,
+    void *data)
+{
+	struct field_work_data *work = (struct field_work_data *)data;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
 #endif
 	for (size_t i = from; i < to; i++) {
 		struct frag *frag = efp->frags + i;
 
 		for (size_t j = 0; j < frag->n_polarizable_pts; j++) {
-			struct polarizable_pt *pt = frag->polarizable_pts + j;
 			size_t idx = frag->polarizable_offset + j;
 
-			energy += 0.5 * vec_dot(&efp->indipconj[idx],
-						&pt->elec_field_wf) -
-				  0.5 * vec_dot(&efp->indip[idx],
-						&pt->elec_field);
+			get_induced_dipole_field(efp, i, j, work->dip,
+			    work->dip_conj, work->field + idx,
+			    work->field_conj + idx);
 		}
 	}
+}
 
-	*(double *)data += energy;
+/* field of dipoles and conjugate dipoles at all polarizable points */
+static void
+compute_dipole_field(struct efp *efp, const vec_t *dip,
+    const vec_t *dip_conj, vec_t *field, vec_t *field_conj)
+{
+	struct field_work_data data = { dip, dip_conj, field, field_conj };
+	size_t npts = efp->n_polarizable_pts;
+
+	memset(field, 0, npts * sizeof(vec_t));
+	memset(field_conj, 0, npts * sizeof(vec_t));
+
+	efp_balance_work(efp, compute_dipole_field_range, &data);
+
+	efp_allreduce(efp, (double *)field, 3 * npts);
+	efp_allreduce(efp, (double *)field_conj, 3 * npts);
+}
+
+/* out = A in and out_conj = A^T in_conj for polarizability tensors A,
+ * returns sum of lengths of output vectors */
+static double
+apply_pol_tensor(struct efp *efp, const vec_t *in, const vec_t *in_conj,
+    vec_t *out, vec_t *out_conj)
+{
+	double sum = 0.0;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(+:sum)
+#endif
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		struct frag *frag = efp->frags + i;
+
+		for (size_t j = 0; j < frag->n_polarizable_pts; j++) {
+			const mat_t *tensor = &frag->polarizable_pts[j].tensor;
+			size_t idx = frag->polarizable_offset + j;
+
+			out[idx] = mat_vec(tensor, in + idx);
+			out_conj[idx] = mat_trans_vec(tensor, in_conj + idx);
+
+			sum += vec_len(out + idx) + vec_len(out_conj + idx);
+		}
+	}
+	return sum;
 }
 
+static double
+dot_vec_array(const vec_t *a, const vec_t *b, size_t n)
+{
+	double sum = 0.0;
+
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:sum)
+#endif
+	for (size_t i = 0; i < n; i++)
+		sum += vec_dot(a + i, b + i);
+
+	return sum;
+}
+
+static int
+is_zero_vec_array(const vec_t *a, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		if (a[i].x != 0.0 || a[i].y != 0.0 || a[i].z != 0.0)
+			return 0;
+
+	return 1;
+}
+
+/* a = b + c * a */
+static void
+update_vec_array(vec_t *a, const vec_t *b, double c, size_t n)
+{
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (size_t i = 0; i < n; i++) {
+		a[i].x = b[i].x + c * a[i].x;
+		a[i].y = b[i].y + c * a[i].y;
+		a[i].z = b[i].z + c * a[i].z;
+	}
+}
+
+/* a = a + c * b */
+static void
+add_vec_array(vec_t *a, const vec_t *b, double c, size_t n)
+{
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (size_t i = 0; i < n; i++) {
+		a[i].x += c * b[i].x;
+		a[i].y += c * b[i].y;
+		a[i].z += c * b[i].z;
+	}
+}
+
+/*
+ * Preconditioned biconjugate gradient solver.
+ *
+ * Induced dipoles satisfy M x = E and conjugate induced dipoles satisfy
+ * M^T x' = E, where M = A^-1 - T, A is the block-diagonal matrix of
+ * polarizability tensors, T is the dipole field tensor and E is the static
+ * field. BiCG solves both systems at once and needs a single pass over
+ * fragment pairs per iteration. For symmetric polarizability tensors it
+ * reduces to the conjugate gradient method.
+ *
+ * Dipoles of the same fragment do not interact, so the fragment block of M
+ * is A^-1 and block-Jacobi preconditioning is multiplication by A. Search
+ * directions are stored both as p = A s and as s so that M p = s - T p is
+ * computed without inverting polarizability tensors. Convergence is
+ * checked using preconditioned residuals A r, which are the changes the
+ * iterative solver would make to the dipoles.
+ */
 static enum efp_result
-efp_compute_id_iterative(struct efp *efp)
+efp_compute_id_cg(struct efp *efp)
 {
-	memset(efp->indip, 0, efp->n_polarizable_pts * sizeof(vec_t));
-	memset(efp->indipconj, 0, efp->n_polarizable_pts * sizeof(vec_t));
+	size_t npts = efp->n_polarizable_pts;
+	double tol = get_pol_scf_tol(efp);
+	size_t max_iter = get_pol_scf_max_iter(efp);
+	enum efp_result res = EFP_RESULT_POL_NOT_CONVERGED;
+	vec_t *buf, *x, *x_c, *r, *r_c, *s, *s_c, *p, *p_c, *q, *q_c;
+	double rho, conv;
 
-	for (size_t iter = 1; iter <= POL_SCF_MAX_ITER; iter++) {
-		if (pol_scf_iter(efp) < POL_SCF_TOL)
+	if (npts == 0)
+		return EFP_RESULT_SUCCESS;
+
+	buf = (vec_t *)malloc(8 * npts * sizeof(vec_t));
+	if (buf == NULL)
+		return EFP_RESULT_NO_MEMORY;
+
+	x = efp->indip;
+	x_c = efp->indipconj;
+	r = buf + 0 * npts;
+	r_c = buf + 1 * npts;
+	s = buf + 2 * npts;
+	s_c = buf + 3 * npts;
+	p = buf + 4 * npts;
+	p_c = buf + 5 * npts;
+	q = buf + 6 * npts;
+	q_c = buf + 7 * npts;
+
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		struct frag *frag = efp->frags + i;
+
+		for (size_t j = 0; j < frag->n_polarizable_pts; j++) {
+			struct polarizable_pt *pt = frag->polarizable_pts + j;
+			size_t idx = frag->polarizable_offset + j;
+
+			r[idx] = vec_add(&pt->elec_field, &pt->elec_field_wf);
+			r_c[idx] = r[idx];
+		}
+	}
+
+	if (!is_zero_vec_array(x, npts) || !is_zero_vec_array(x_c, npts)) {
+		/* One iterative step from initial guess x0 gives
+		 * x = A (E + T x0) and the residual r = T (x - x0). */
+		compute_dipole_field(efp, x, x_c, q, q_c);
+		memcpy(s, x, npts * sizeof(vec_t));
+		memcpy(s_c, x_c, npts * sizeof(vec_t));
+		add_vec_array(q, r, 1.0, npts);
+		add_vec_array(q_c, r_c, 1.0, npts);
+		apply_pol_tensor(efp, q, q_c, x, x_c);
+		update_vec_array(s, x, -1.0, npts);
+		update_vec_array(s_c, x_c, -1.0, npts);
+		compute_dipole_field(efp, s, s_c, r, r_c);
+	}
+
+	conv = apply_pol_tensor(efp, r, r_c, p, p_c);
+	memcpy(s, r, npts * sizeof(vec_t));
+	memcpy(s_c, r_c, npts * sizeof(vec_t));
+	rho = dot_vec_array(r_c, p, npts);
+
+	for (size_t iter = 0; ; iter++) {
+		double alpha, beta, den, rho_new;
+
+		if (conv / npts / 2 < tol) {
+			res = EFP_RESULT_SUCCESS;
 			break;
-		if (iter == POL_SCF_MAX_ITER)
-			return EFP_RESULT_POL_NOT_CONVERGED;
+		}
+		if (iter == max_iter) {
+			if (efp->opts.disable_pol_conv_check)
+				res = EFP_RESULT_SUCCESS;
+			break;
+		}
+
+		/* q = M p */
+		compute_dipole_field(efp, p, p_c, q, q_c);
+		update_vec_array(q, s, -1.0, npts);
+		update_vec_array(q_c, s_c, -1.0, npts);
+
+		den = dot_vec_array(p_c, q, npts);
+		if (den == 0.0 || rho == 0.0)
+			break;
+
+		alpha = rho / den;
+
+		add_vec_array(x, p, alpha, npts);
+		add_vec_array(x_c, p_c, alpha, npts);
+		add_vec_array(r, q, -alpha, npts);
+		add_vec_array(r_c, q_c, -alpha, npts);
+
+		/* q = A r */
+		conv = apply_pol_tensor(efp, r, r_c, q, q_c);
+		rho_new = dot_vec_array(r_c, q, npts);
+		beta = rho_new / rho;
+		rho = rho_new;
+
+		update_vec_array(s, r, beta, npts);
+		update_vec_array(s_c, r_c, beta, npts);
+		update_vec_array(p, q, beta, npts);
+		update_vec_array(p_c, q_c, beta, npts);
+	}
+
+	free(buf);
+	return res;
+}
+
+/* OPT3 coefficients of perturbation theory partial sums, see
+ * A. C. Simmonett et al., J. Chem. Phys. 143, 074115 (2015) */
+static const double pol_opt_coef[POL_OPT_ORDER + 1] = {
+	-0.154, 0.017, 0.658, 0.474
+};
+
+/*
+ * Extrapolated perturbation theory.
+ *
+ * Perturbation orders of induced dipoles are u_0 = A E and
+ * u_k = A T u_(k-1), and similarly for conjugate dipoles with A^T. Induced
+ * dipoles are the sum of partial sums of u_k with fixed coefficients, which
+ * is the sum of u_k with weights c_k. This needs exactly POL_OPT_ORDER
+ * evaluations of dipole field and never fails.
+ *
+ * The energy is not stationary with respect to the dipoles, so the
+ * gradient of the dipole field tensor term is the sum over k of
+ * interactions of conjugate order k with v_k = sum_j c_(k+j+1) u_j.
+ * These pairs are stored for the gradient in pol_opt.
+ */
+static enum efp_result
+efp_compute_id_opt(struct efp *efp)
+{
+	size_t npts = efp->n_polarizable_pts;
+	double coef[POL_OPT_ORDER + 1];
+	vec_t *buf, *field, *field_conj;
+
+	if (npts == 0)
+		return EFP_RESULT_SUCCESS;
+
+	if (efp->pol_opt == NULL) {
+		efp->pol_opt = (vec_t *)malloc(2 * POL_OPT_ORDER * npts *
+		    sizeof(vec_t));
+		if (efp->pol_opt == NULL)
+			return EFP_RESULT_NO_MEMORY;
+	}
+
+	/* field and all perturbation orders of dipoles */
+	buf = (vec_t *)malloc(2 * (POL_OPT_ORDER + 2) * npts * sizeof(vec_t));
+	if (buf == NULL)
+		return EFP_RESULT_NO_MEMORY;
+
+	field = buf;
+	field_conj = buf + npts;
+
+	coef[POL_OPT_ORDER] = pol_opt_coef[POL_OPT_ORDER];
+	for (size_t k = POL_OPT_ORDER; k > 0; k--)
+		coef[k - 1] = coef[k] + pol_opt_coef[k - 1];
+
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		struct frag *frag = efp->frags + i;
+
+		for (size_t j = 0; j < frag->n_polarizable_pts; j++) {
+			struct polarizable_pt *pt = frag->polarizable_pts + j;
+			size_t idx = frag->polarizable_offset + j;
+
+			field[idx] = vec_add(&pt->elec_field,
+			    &pt->elec_field_wf);
+			field_conj[idx] = field[idx];
+		}
+	}
+
+	memset(efp->indip, 0, npts * sizeof(vec_t));
+	memset(efp->indipconj, 0, npts * sizeof(vec_t));
+
+	for (size_t k = 0; k <= POL_OPT_ORDER; k++) {
+		vec_t *u = buf + 2 * (k + 1) * npts;
+
+		if (k > 0)
+			compute_dipole_field(efp, u - 2 * npts, u - npts,
+			    field, field_conj);
+
+		apply_pol_tensor(efp, field, field_conj, u, u + npts);
+		add_vec_array(efp->indip, u, coef[k], npts);
+		add_vec_array(efp->indipconj, u + npts, coef[k], npts);
 	}
+
+	for (size_t k = 0; k < POL_OPT_ORDER; k++) {
+		vec_t *v = efp->pol_opt + 2 * k * npts;
+		const vec_t *u = buf + 2 * (k + 1) * npts;
+
+		memset(v, 0, npts * sizeof(vec_t));
+
+		for (size_t j = 0; j + k < POL_OPT_ORDER; j++)
+			add_vec_array(v, buf + 2 * (j + 1) * npts,
+			    coef[k + j + 1], npts);
+
+		memcpy(v + npts, u + npts, npts * sizeof(vec_t));
+	}
+
+	free(buf);
 	return EFP_RESULT_SUCCESS;
 }
 
@@ -459,8 +1184,12 @@ efp_compute_pol_energy(struct efp *efp, double *energy)
 
 	assert(energy);
 
+	if ((res = efp_setup_halo(efp)))
+		return res;
 	if ((res = compute_elec_field(efp)))
 		return res;
+	if ((res = setup_dipole_tensors(efp)))
+		return res;
 
 	switch (efp->opts.pol_driver) {
 	case EFP_POL_DRIVER_ITERATIVE:
@@ -469,51 +1198,66 @@ efp_compute_pol_energy(struct efp *efp, double *energy)
 	case EFP_POL_DRIVER_DIRECT:
 		res = efp_compute_id_direct(efp);
 		break;
+	case EFP_POL_DRIVER_CG:
+		res = efp_compute_id_cg(efp);
+		break;
+	case EFP_POL_DRIVER_OPT:
+		res = efp_compute_id_opt(efp);
+		break;
 	}
 
-	if (res)
+	if (res) {
+		/* do not start next solution from diverged dipoles */
+		memset(efp->indip, 0, efp->n_polarizable_pts * sizeof(vec_t));
+		memset(efp->indipconj, 0,
+		    efp->n_polarizable_pts * sizeof(vec_t));
+		efp->n_pol_hist = 0;
 		return res;
+	}
 
 	*energy = 0.0;
-	efp_balance_work(efp, compute_energy_range, energy);
-	efp_allreduce(energy, 1);
+
+	if (efp->dist_pol)
+		compute_energy_owned(efp, energy);
+	else
+		efp_balance_work(efp, compute_energy_range, energy);
+
+	efp_allreduce(efp, energy, 1);
 
 	return EFP_RESULT_SUCCESS;
 }
 
-static void
-compute_grad_point(struct efp *efp, size_t frag_idx, size_t pt_idx)
+/* gradient of interaction of induced dipoles of fragment i with nuclei and
+ * multipoles of fragment j, returns energy without switching applied */
+static double
+compute_grad_perm(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
+    const struct swf *swf)
 {
-	const struct frag *fr_i = efp->frags + frag_idx;
-	const struct polarizable_pt *pt_i = fr_i->polarizable_pts + pt_idx;
-	size_t idx_i = fr_i->polarizable_offset + pt_idx;
+	struct workspace *ws = efp_get_workspace(efp);
+	const struct frag *fr_i = efp->frags + fr_i_idx;
+	const struct frag *fr_j = efp->frags + fr_j_idx;
 	vec_t force, add_i, add_j, force_, add_i_, add_j_;
-	double e;
+	double e, energy = 0.0;
 
-	vec_t dipole_i = {
-		0.5 * (efp->indip[idx_i].x + efp->indipconj[idx_i].x),
-		0.5 * (efp->indip[idx_i].y + efp->indipconj[idx_i].y),
-		0.5 * (efp->indip[idx_i].z + efp->indipconj[idx_i].z)
-	};
+	for (size_t pt_idx = 0; pt_idx < fr_i->n_polarizable_pts; pt_idx++) {
+		const struct polarizable_pt *pt_i =
+		    fr_i->polarizable_pts + pt_idx;
+		size_t idx_i = fr_i->polarizable_offset + pt_idx;
 
-	for (size_t j = 0; j < efp->n_frag; j++) {
-		if (j == frag_idx || efp_skip_frag_pair(efp, frag_idx, j))
-			continue;
-
-		struct frag *fr_j = efp->frags + j;
-		struct swf swf = efp_make_swf(efp, fr_i, fr_j);
-
-		/* energy without switching applied */
-		double energy = 0.0;
+		vec_t dipole_i = {
+			0.5 * (efp->indip[idx_i].x + efp->indipconj[idx_i].x),
+			0.5 * (efp->indip[idx_i].y + efp->indipconj[idx_i].y),
+			0.5 * (efp->indip[idx_i].z + efp->indipconj[idx_i].z)
+		};
 
 		/* induced dipole - nuclei */
 		for (size_t k = 0; k < fr_j->n_atoms; k++) {
 			struct efp_atom *at_j = fr_j->atoms + k;
 
 			vec_t dr = {
-				at_j->x - pt_i->x - swf.cell.x,
-				at_j->y - pt_i->y - swf.cell.y,
-				at_j->z - pt_i->z - swf.cell.z
+				at_j->x - pt_i->x - swf->cell.x,
+				at_j->y - pt_i->y - swf->cell.y,
+				at_j->z - pt_i->z - swf->cell.z
 			};
 
 			double p1 = 1.0, p2 = 0.0;
@@ -541,15 +1285,15 @@ compute_grad_point(struct efp *efp, size_t frag_idx, size_t pt_idx)
 			force.y += p2 * e * dr.y;
 			force.z += p2 * e * dr.z;
 
-			vec_scale(&force, swf.swf);
-			vec_scale(&add_i, swf.swf);
-			vec_scale(&add_j, swf.swf);
+			vec_scale(&force, swf->swf);
+			vec_scale(&add_i, swf->swf);
+			vec_scale(&add_j, swf->swf);
 
-			efp_add_force(efp->grad + frag_idx, CVEC(fr_i->x),
+			efp_add_force(ws->grad + fr_i_idx, CVEC(fr_i->x),
 			    CVEC(pt_i->x), &force, &add_i);
-			efp_sub_force(efp->grad + j, CVEC(fr_j->x),
+			efp_sub_force(ws->grad + fr_j_idx, CVEC(fr_j->x),
 			    CVEC(at_j->x), &force, &add_j);
-			efp_add_stress(&swf.dr, &force, &efp->stress);
+			efp_add_stress(&swf->dr, &force, ws->stress);
 
 			energy += p1 * e;
 		}
@@ -559,9 +1303,9 @@ compute_grad_point(struct efp *efp, size_t frag_idx, size_t pt_idx)
 			struct multipole_pt *pt_j = fr_j->multipole_pts + k;
 
 			vec_t dr = {
-				pt_j->x - pt_i->x - swf.cell.x,
-				pt_j->y - pt_i->y - swf.cell.y,
-				pt_j->z - pt_i->z - swf.cell.z
+				pt_j->x - pt_i->x - swf->cell.x,
+				pt_j->y - pt_i->y - swf->cell.y,
+				pt_j->z - pt_i->z - swf->cell.z
 			};
 
 			double p1 = 1.0, p2 = 0.0;
@@ -615,34 +1359,62 @@ compute_grad_point(struct efp *efp, size_t frag_idx, size_t pt_idx)
 			force.y += p2 * e * dr.y;
 			force.z += p2 * e * dr.z;
 
-			vec_scale(&force, swf.swf);
-			vec_scale(&add_i, swf.swf);
-			vec_scale(&add_j, swf.swf);
+			vec_scale(&force, swf->swf);
+			vec_scale(&add_i, swf->swf);
+			vec_scale(&add_j, swf->swf);
 
-			efp_add_force(efp->grad + frag_idx, CVEC(fr_i->x),
+			efp_add_force(ws->grad + fr_i_idx, CVEC(fr_i->x),
 			    CVEC(pt_i->x), &force, &add_i);
-			efp_sub_force(efp->grad + j, CVEC(fr_j->x),
+			efp_sub_force(ws->grad + fr_j_idx, CVEC(fr_j->x),
 			    CVEC(pt_j->x), &force, &add_j);
-			efp_add_stress(&swf.dr, &force, &efp->stress);
+			efp_add_stress(&swf->dr, &force, ws->stress);
 
 			energy += p1 * e;
 		}
 
-		/* induced dipole - induced dipoles */
+	}
+	return energy;
+}
+
+/* gradient of induced dipole - induced dipole interaction between fragments
+ * i and j for given dipoles and conjugate dipoles, both directions of each
+ * pair of points are computed together, returns energy without switching
+ * applied */
+static double
+compute_grad_indip(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
+    const struct swf *swf, const vec_t *dip, const vec_t *dip_conj)
+{
+	struct workspace *ws = efp_get_workspace(efp);
+	const struct frag *fr_i = efp->frags + fr_i_idx;
+	const struct frag *fr_j = efp->frags + fr_j_idx;
+	vec_t force, add_i, add_j, force_, add_i_, add_j_;
+	double e, energy = 0.0;
+
+	for (size_t ii = 0; ii < fr_i->n_polarizable_pts; ii++) {
+		const struct polarizable_pt *pt_i = fr_i->polarizable_pts + ii;
+		size_t idx_i = fr_i->polarizable_offset + ii;
+
+		vec_t half_dipole_i = {
+			0.5 * dip[idx_i].x,
+			0.5 * dip[idx_i].y,
+			0.5 * dip[idx_i].z
+		};
+
 		for (size_t jj = 0; jj < fr_j->n_polarizable_pts; jj++) {
-			struct polarizable_pt *pt_j = fr_j->polarizable_pts+jj;
-			size_t idx_j = fr_j->polarizable_offset+jj;
+			const struct polarizable_pt *pt_j =
+			    fr_j->polarizable_pts + jj;
+			size_t idx_j = fr_j->polarizable_offset + jj;
 
 			vec_t dr = {
-				pt_j->x - pt_i->x - swf.cell.x,
-				pt_j->y - pt_i->y - swf.cell.y,
-				pt_j->z - pt_i->z - swf.cell.z
+				pt_j->x - pt_i->x - swf->cell.x,
+				pt_j->y - pt_i->y - swf->cell.y,
+				pt_j->z - pt_i->z - swf->cell.z
 			};
 
-			vec_t half_dipole_i = {
-				0.5 * efp->indip[idx_i].x,
-				0.5 * efp->indip[idx_i].y,
-				0.5 * efp->indip[idx_i].z
+			vec_t half_dipole_j = {
+				0.5 * dip[idx_j].x,
+				0.5 * dip[idx_j].y,
+				0.5 * dip[idx_j].z
 			};
 
 			double p1 = 1.0, p2 = 0.0;
@@ -656,13 +1428,23 @@ compute_grad_point(struct efp *efp, size_t frag_idx, size_t pt_idx)
 				    fr_j->pol_damp);
 			}
 
+			/* induced dipole i - conjugate induced dipole j */
 			e = efp_dipole_dipole_energy(&half_dipole_i,
-			    &efp->indipconj[idx_j], &dr);
+			    &dip_conj[idx_j], &dr);
 			efp_dipole_dipole_grad(&half_dipole_i,
-			    &efp->indipconj[idx_j], &dr, &force,
+			    &dip_conj[idx_j], &dr, &force,
 			    &add_i, &add_j);
 			vec_negate(&add_j);
 
+			/* conjugate induced dipole i - induced dipole j */
+			e += efp_dipole_dipole_energy(&dip_conj[idx_i],
+			    &half_dipole_j, &dr);
+			efp_dipole_dipole_grad(&dip_conj[idx_i],
+			    &half_dipole_j, &dr, &force_, &add_i_, &add_j_);
+			vec_negate(&add_j_);
+			add_3(&force, &force_, &add_i, &add_i_,
+			    &add_j, &add_j_);
+
 			vec_scale(&force, p1);
 			vec_scale(&add_i, p1);
 			vec_scale(&add_j, p1);
@@ -671,41 +1453,93 @@ compute_grad_point(struct efp *efp, size_t frag_idx, size_t pt_idx)
 			force.y += p2 * e * dr.y;
 			force.z += p2 * e * dr.z;
 
-			vec_scale(&force, swf.swf);
-			vec_scale(&add_i, swf.swf);
-			vec_scale(&add_j, swf.swf);
+			vec_scale(&force, swf->swf);
+			vec_scale(&add_i, swf->swf);
+			vec_scale(&add_j, swf->swf);
 
-			efp_add_force(efp->grad + frag_idx, CVEC(fr_i->x),
+			efp_add_force(ws->grad + fr_i_idx, CVEC(fr_i->x),
 			    CVEC(pt_i->x), &force, &add_i);
-			efp_sub_force(efp->grad + j, CVEC(fr_j->x),
+			efp_sub_force(ws->grad + fr_j_idx, CVEC(fr_j->x),
 			    CVEC(pt_j->x), &force, &add_j);
-			efp_add_stress(&swf.dr, &force, &efp->stress);
+			efp_add_stress(&swf->dr, &force, ws->stress);
 			energy += p1 * e;
 		}
+	}
+	return energy;
+}
 
-		force.x = swf.dswf.x * energy;
-		force.y = swf.dswf.y * energy;
-		force.z = swf.dswf.z * energy;
-		six_atomic_add_xyz(efp->grad + frag_idx, &force);
-		six_atomic_sub_xyz(efp->grad + j, &force);
-		efp_add_stress(&swf.dr, &force, &efp->stress);
+static void
+compute_grad_pair(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx)
+{
+	struct workspace *ws = efp_get_workspace(efp);
+	struct swf swf = efp_make_swf(efp, efp->frags + fr_i_idx,
+	    efp->frags + fr_j_idx);
+	size_t npts = efp->n_polarizable_pts;
+	double energy = 0.0;
+	vec_t force;
+
+	if (efp->opts.pol_driver == EFP_POL_DRIVER_OPT) {
+		for (size_t k = 0; k < POL_OPT_ORDER; k++) {
+			const vec_t *dip = efp->pol_opt + 2 * k * npts;
+
+			energy += compute_grad_indip(efp, fr_i_idx, fr_j_idx,
+			    &swf, dip, dip + npts);
+		}
+	} else {
+		energy = compute_grad_indip(efp, fr_i_idx, fr_j_idx, &swf,
+		    efp->indip, efp->indipconj);
 	}
 
-	/* induced dipole - ab initio nuclei */
-	if (efp->opts.terms & EFP_TERM_AI_POL) {
+	energy += compute_grad_perm(efp, fr_i_idx, fr_j_idx, &swf);
+
+	reverse_swf(&swf);
+	energy += compute_grad_perm(efp, fr_j_idx, fr_i_idx, &swf);
+	reverse_swf(&swf);
+
+	force.x = swf.dswf.x * energy;
+	force.y = swf.dswf.y * energy;
+	force.z = swf.dswf.z * energy;
+	six_add_xyz(ws->grad + fr_i_idx, &force);
+	six_sub_xyz(ws->grad + fr_j_idx, &force);
+	efp_add_stress(&swf.dr, &force, ws->stress);
+}
+
+/* gradient of interaction of induced dipoles of a fragment with ab initio
+ * nuclei */
+static void
+compute_grad_ai(struct efp *efp, size_t frag_idx)
+{
+	struct workspace *ws = efp_get_workspace(efp);
+	const struct frag *fr_i = efp->frags + frag_idx;
+	vec_t force, add_i, add_j;
+
+	for (size_t pt_idx = 0; pt_idx < fr_i->n_polarizable_pts; pt_idx++) {
+		const struct polarizable_pt *pt_i =
+		    fr_i->polarizable_pts + pt_idx;
+		size_t idx_i = fr_i->polarizable_offset + pt_idx;
+
+		vec_t dipole_i = {
+			0.5 * (efp->indip[idx_i].x + efp->indipconj[idx_i].x),
+			0.5 * (efp->indip[idx_i].y + efp->indipconj[idx_i].y),
+			0.5 * (efp->indip[idx_i].z + efp->indipconj[idx_i].z)
+		};
+
 		for (size_t j = 0; j < efp->n_ptc; j++) {
 			vec_t dr = vec_sub(efp->ptc_xyz + j, CVEC(pt_i->x));
 
 			efp_charge_dipole_grad(efp->ptc[j], &dipole_i, &dr,
 			    &force, &add_j, &add_i);
 			vec_negate(&add_i);
-			vec_atomic_add(efp->ptc_grad + j, &force);
-			efp_sub_force(efp->grad + frag_idx, CVEC(fr_i->x),
+			ws->ptc_grad[j] = vec_add(ws->ptc_grad + j, &force);
+			efp_sub_force(ws->grad + frag_idx, CVEC(fr_i->x),
 			    CVEC(pt_i->x), &force, &add_i);
 		}
 	}
 }
 
+/* Each owned pair of fragments is visited once. Induced dipole - induced
+ * dipole terms of both directions share distances and damping; terms with
+ * permanent multipoles are computed for induced dipoles on both sides. */
 static void
 compute_grad_range(struct efp *efp, size_t from, size_t to, void *data)
 {
@@ -714,9 +1548,98 @@ compute_grad_range(struct efp *efp, size_t from, size_t to, void *data)
 #ifdef _OPENMP
 #pragma omp parallel for schedule(dynamic)
 #endif
-	for (size_t i = from; i < to; i++)
-		for (size_t j = 0; j < efp->frags[i].n_polarizable_pts; j++)
-			compute_grad_point(efp, i, j);
+	for (size_t i = from; i < to; i++) {
+		size_t pair_from = efp_get_pair_offset(efp, i);
+		size_t pair_to = efp_get_pair_offset(efp, i + 1);
+
+		for (size_t p = pair_from; p < pair_to; p++) {
+			size_t j = efp_get_pair(efp, i, p);
+
+			if (!efp_skip_frag_pair(efp, i, j))
+				compute_grad_pair(efp, i, j);
+		}
+
+		if (efp->opts.terms & EFP_TERM_AI_POL)
+			compute_grad_ai(efp, i);
+	}
+}
+
+static double
+binomial(size_t n, size_t k)
+{
+	double c = 1.0;
+
+	for (size_t i = 1; i <= k; i++)
+		c = c * (double)(n - k + i) / (double)i;
+
+	return c;
+}
+
+/* ASPC coefficient j = 1 .. k + 2 of order k, see J. Kolafa,
+ * J. Comput. Chem. 25, 335 (2004) */
+static double
+get_aspc_coef(size_t k, size_t j)
+{
+	double c = (double)j * binomial(2 * k + 4, k + 2 - j) /
+	    binomial(2 * k + 2, k + 1);
+
+	return j % 2 ? c : -c;
+}
+
+/* Solvers start from current induced dipoles which hold the previous
+ * solution. With longer history they are replaced by an extrapolation. */
+static enum efp_result
+predict_induced_dipoles(struct efp *efp)
+{
+	size_t npts = efp->n_polarizable_pts;
+	size_t n_hist = efp->n_pol_hist;
+
+	if (efp->opts.pol_history < 2) {
+		free(efp->pol_hist);
+		efp->pol_hist = NULL;
+		efp->n_pol_hist = 0;
+		return EFP_RESULT_SUCCESS;
+	}
+	if (efp->pol_hist == NULL) {
+		efp->pol_hist = (vec_t *)malloc(efp->opts.pol_history * 2 *
+		    npts * sizeof(vec_t));
+		if (efp->pol_hist == NULL)
+			return EFP_RESULT_NO_MEMORY;
+	}
+	if (n_hist < 2)
+		return EFP_RESULT_SUCCESS;
+
+	memset(efp->indip, 0, npts * sizeof(vec_t));
+	memset(efp->indipconj, 0, npts * sizeof(vec_t));
+
+	for (size_t j = 1; j <= n_hist; j++) {
+		const vec_t *hist = efp->pol_hist + (j - 1) * 2 * npts;
+
+		add_vec_array(efp->indip, hist, get_aspc_coef(n_hist - 2, j),
+		    npts);
+		add_vec_array(efp->indipconj, hist + npts,
+		    get_aspc_coef(n_hist - 2, j), npts);
+	}
+	return EFP_RESULT_SUCCESS;
+}
+
+static void
+store_induced_dipoles(struct efp *efp)
+{
+	size_t npts = efp->n_polarizable_pts;
+	size_t n_hist = efp->n_pol_hist;
+
+	if (efp->pol_hist == NULL)
+		return;
+	if (n_hist == efp->opts.pol_history)
+		n_hist--;
+
+	memmove(efp->pol_hist + 2 * npts, efp->pol_hist,
+	    n_hist * 2 * npts * sizeof(vec_t));
+	memcpy(efp->pol_hist, efp->indip, npts * sizeof(vec_t));
+	memcpy(efp->pol_hist + npts, efp->indipconj, npts * sizeof(vec_t));
+
+	efp->n_pol_hist = n_hist + 1;
 }
 
 enum efp_result
@@ -728,11 +1651,17 @@ efp_compute_pol(struct efp *efp)
 	    !(efp->opts.terms & EFP_TERM_AI_POL))
 		return EFP_RESULT_SUCCESS;
 
+	if ((res = predict_induced_dipoles(efp)))
+		return res;
 	if ((res = efp_compute_pol_energy(efp, &efp->energy.polarization)))
 		return res;
 
-	if (efp->do_gradient)
+	store_induced_dipoles(efp);
+
+	if (efp->do_gradient) {
 		efp_balance_work(efp, compute_grad_range, NULL);
+		efp_reduce_gradient(efp);
+	}
 
 	return EFP_RESULT_SUCCESS;
 }
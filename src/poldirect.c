@@ -46,15 +46,20 @@ copy_matrix(double *dst, size_t n, size_t off_i, size_t off_j, const mat_t *m)
 	dst[n * (3 * off_i + 2) + 3 * off_j + 2] = m->zz;
 }
 
+/* stores upper triangle of a symmetric block in packed column-major format */
 static void
-transpose_matrix(double *m, size_t n)
+copy_matrix_packed(double *dst, size_t off_i, size_t off_j, const mat_t *m)
 {
-	for (size_t i = 0; i < n; i++)
-		for (size_t j = i + 1; j < n; j++) {
-			double t = m[n * i + j];
-			m[n * i + j] = m[n * j + i];
-			m[n * j + i] = t;
+	for (size_t a = 0; a < 3; a++) {
+		for (size_t b = 0; b < 3; b++) {
+			size_t row = 3 * off_i + a;
+			size_t col = 3 * off_j + b;
+
+			if (row <= col)
+				dst[row + col * (col + 1) / 2] =
+				    mat_get(m, a, b);
 		}
+	}
 }
 
 static mat_t
@@ -95,41 +100,98 @@ get_int_mat(const struct efp *efp, size_t i, size_t j, size_t ii, size_t jj)
 }
 
 static void
-compute_lhs(const struct efp *efp, double *c, int conj)
+compute_lhs_block(const struct efp *efp, double *c, size_t i, size_t ii,
+    size_t j)
 {
-	size_t i, ii, j, jj, offset_i, offset_j;
 	size_t n = 3 * efp->n_polarizable_pts;
+	const struct frag *fr_i = efp->frags + i;
+	const struct frag *fr_j = efp->frags + j;
+	const struct polarizable_pt *pt_i = fr_i->polarizable_pts + ii;
+	size_t offset_i = fr_i->polarizable_offset + ii;
 
-	for (i = 0, offset_i = 0; i < efp->n_frag; i++) {
-	for (ii = 0; ii < efp->frags[i].n_polarizable_pts; ii++, offset_i++) {
-	for (j = 0, offset_j = 0; j < efp->n_frag; j++) {
-	for (jj = 0; jj < efp->frags[j].n_polarizable_pts; jj++, offset_j++) {
-		if (i == j) {
-			if (ii == jj) {
-				copy_matrix(c, n, offset_i, offset_j,
-				    &mat_identity);
-			} else {
-				copy_matrix(c, n, offset_i, offset_j,
-				    &mat_zero);
-			}
-			continue;
-		}
-		const struct polarizable_pt *pt_i =
-		    efp->frags[i].polarizable_pts + ii;
+	for (size_t jj = 0; jj < fr_j->n_polarizable_pts; jj++) {
+		size_t offset_j = fr_j->polarizable_offset + jj;
 		mat_t m = get_int_mat(efp, i, j, ii, jj);
 
-		if (conj)
-			m = mat_trans_mat(&pt_i->tensor, &m);
-		else
-			m = mat_mat(&pt_i->tensor, &m);
-
+		m = mat_mat(&pt_i->tensor, &m);
 		mat_negate(&m);
 		copy_matrix(c, n, offset_i, offset_j, &m);
-	}}}}
+	}
 }
 
+/* row-major 1 - A T, which LAPACK sees as its transpose */
 static void
-compute_rhs(const struct efp *efp, vec_t *id, int conj)
+compute_lhs(const struct efp *efp, double *c)
+{
+	size_t n = 3 * efp->n_polarizable_pts;
+
+	memset(c, 0, n * n * sizeof(double));
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		const struct frag *fr_i = efp->frags + i;
+		size_t n_nb = efp_get_nb_count(efp, i);
+
+		for (size_t ii = 0; ii < fr_i->n_polarizable_pts; ii++) {
+			size_t offset_i = fr_i->polarizable_offset + ii;
+
+			copy_matrix(c, n, offset_i, offset_i, &mat_identity);
+
+			/* blocks of fragments beyond cutoff remain zero */
+			for (size_t k = 0; k < n_nb; k++)
+				compute_lhs_block(efp, c, i, ii,
+				    efp_get_nb(efp, i, k));
+		}
+	}
+}
+
+/* upper triangle of A^-1 - T in packed format */
+static void
+compute_lhs_packed(const struct efp *efp, double *c)
+{
+	size_t n = 3 * efp->n_polarizable_pts;
+
+	memset(c, 0, n * (n + 1) / 2 * sizeof(double));
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		const struct frag *fr_i = efp->frags + i;
+		size_t n_nb = efp_get_nb_count(efp, i);
+
+		for (size_t ii = 0; ii < fr_i->n_polarizable_pts; ii++) {
+			const struct polarizable_pt *pt_i =
+			    fr_i->polarizable_pts + ii;
+			size_t offset_i = fr_i->polarizable_offset + ii;
+			mat_t m = mat_inv(&pt_i->tensor);
+
+			copy_matrix_packed(c, offset_i, offset_i, &m);
+
+			for (size_t k = 0; k < n_nb; k++) {
+				size_t j = efp_get_nb(efp, i, k);
+				const struct frag *fr_j = efp->frags + j;
+
+				/* lower triangle is not stored */
+				if (j < i)
+					continue;
+
+				for (size_t jj = 0;
+				    jj < fr_j->n_polarizable_pts; jj++) {
+					m = get_int_mat(efp, i, j, ii, jj);
+					mat_negate(&m);
+					copy_matrix_packed(c, offset_i,
+					    fr_j->polarizable_offset + jj, &m);
+				}
+			}
+		}
+	}
+}
+
+static void
+compute_rhs(const struct efp *efp, vec_t *id, vec_t *id_conj)
 {
 	for (size_t i = 0, idx = 0; i < efp->n_frag; i++) {
 		const struct frag *frag = efp->frags + i;
@@ -140,24 +202,55 @@ compute_rhs(const struct efp *efp, vec_t *id, int conj)
 			vec_t field = vec_add(&pt->elec_field,
 			    &pt->elec_field_wf);
 
-			if (conj)
-				id[idx] = mat_trans_vec(&pt->tensor, &field);
-			else
-				id[idx] = mat_vec(&pt->tensor, &field);
+			id[idx] = mat_vec(&pt->tensor, &field);
+			id_conj[idx] = field;
 		}
 	}
 }
 
-enum efp_result
-efp_compute_id_direct(struct efp *efp)
+/* nonzero if all polarizability tensors are symmetric and invertible */
+static int
+is_symmetric(const struct efp *efp)
+{
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		const struct frag *frag = efp->frags + i;
+
+		for (size_t j = 0; j < frag->n_polarizable_pts; j++) {
+			const mat_t *m = &frag->polarizable_pts[j].tensor;
+			double eps = 1.0e-12 * (fabs(m->xx) + fabs(m->yy) +
+			    fabs(m->zz));
+
+			if (fabs(m->xy - m->yx) > eps ||
+			    fabs(m->xz - m->zx) > eps ||
+			    fabs(m->yz - m->zy) > eps ||
+			    mat_det(m) == 0.0)
+				return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Induced dipoles x and conjugate induced dipoles x' satisfy
+ *
+ *   (1 - A T) x = A E,  (1 - A^T T) x' = A^T E,
+ *
+ * where A are polarizability tensors, T are dipole field tensors and E is
+ * the static field. As T is symmetric, 1 - A^T T = A^T (1 - A T)^T A^-T, so
+ * x' = A^T y where (1 - A T)^T y = E, and one LU factorization serves both
+ * systems. If all A are symmetric both systems are equivalent to
+ * (A^-1 - T) x = E with a symmetric matrix, which is factored in packed
+ * format using half of the memory.
+ */
+static enum efp_result
+compute_id_sym(struct efp *efp)
 {
+	size_t n = 3 * efp->n_polarizable_pts;
 	double *c;
-	size_t n;
 	fortranint_t *ipiv;
-	enum efp_result res;
+	enum efp_result res = EFP_RESULT_SUCCESS;
 
-	n = 3 * efp->n_polarizable_pts;
-	c = (double *)calloc(n * n, sizeof *c);
+	c = (double *)malloc(n * (n + 1) / 2 * sizeof *c);
 	ipiv = (fortranint_t *)calloc(n, sizeof *ipiv);
 
 	if (c == NULL || ipiv == NULL) {
@@ -165,32 +258,405 @@ efp_compute_id_direct(struct efp *efp)
 		goto error;
 	}
 
-	/* induced dipoles */
-	compute_lhs(efp, c, 0);
-	compute_rhs(efp, efp->indip, 0);
-	transpose_matrix(c, n);
+	/* right hand side E goes to indip */
+	compute_lhs_packed(efp, c);
+	compute_rhs(efp, efp->indipconj, efp->indip);
 
-	if (efp_dgesv((fortranint_t)n, 1, c, (fortranint_t)n, ipiv,
+	if (efp_dsptrf('U', (fortranint_t)n, c, ipiv) != 0) {
+		efp_log("dsptrf: error factoring polarization matrix");
+		res = EFP_RESULT_FATAL;
+		goto error;
+	}
+	if (efp_dsptrs('U', (fortranint_t)n, 1, c, ipiv,
 	    (double *)efp->indip, (fortranint_t)n) != 0) {
-		efp_log("dgesv: error solving for induced dipoles");
+		efp_log("dsptrs: error solving for induced dipoles");
 		res = EFP_RESULT_FATAL;
 		goto error;
 	}
+	memcpy(efp->indipconj, efp->indip,
+	    efp->n_polarizable_pts * sizeof(vec_t));
+error:
+	free(c);
+	free(ipiv);
+	return res;
+}
 
-	/* conjugate induced dipoles */
-	compute_lhs(efp, c, 1);
-	compute_rhs(efp, efp->indipconj, 1);
-	transpose_matrix(c, n);
+static enum efp_result
+compute_id_lu(struct efp *efp)
+{
+	size_t n = 3 * efp->n_polarizable_pts;
+	double *c;
+	fortranint_t *ipiv;
+	enum efp_result res = EFP_RESULT_SUCCESS;
+
+	c = (double *)malloc(n * n * sizeof *c);
+	ipiv = (fortranint_t *)calloc(n, sizeof *ipiv);
+
+	if (c == NULL || ipiv == NULL) {
+		res = EFP_RESULT_NO_MEMORY;
+		goto error;
+	}
+
+	compute_lhs(efp, c);
+	compute_rhs(efp, efp->indip, efp->indipconj);
+
+	if (efp_dgetrf((fortranint_t)n, (fortranint_t)n, c, (fortranint_t)n,
+	    ipiv) != 0) {
+		efp_log("dgetrf: error factoring polarization matrix");
+		res = EFP_RESULT_FATAL;
+		goto error;
+	}
 
-	if (efp_dgesv((fortranint_t)n, 1, c, (fortranint_t)n, ipiv,
+	/* induced dipoles */
+	if (efp_dgetrs('T', (fortranint_t)n, 1, c, (fortranint_t)n, ipiv,
+	    (double *)efp->indip, (fortranint_t)n) != 0) {
+		efp_log("dgetrs: error solving for induced dipoles");
+		res = EFP_RESULT_FATAL;
+		goto error;
+	}
+
+	/* conjugate induced dipoles */
+	if (efp_dgetrs('N', (fortranint_t)n, 1, c, (fortranint_t)n, ipiv,
 	    (double *)efp->indipconj, (fortranint_t)n) != 0) {
-		efp_log("dgesv: error solving for conjugate induced dipoles");
+		efp_log("dgetrs: error solving for conjugate induced dipoles");
 		res = EFP_RESULT_FATAL;
 		goto error;
 	}
-	res = EFP_RESULT_SUCCESS;
+
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		const struct frag *frag = efp->frags + i;
+
+		for (size_t j = 0; j < frag->n_polarizable_pts; j++) {
+			size_t idx = frag->polarizable_offset + j;
+
+			efp->indipconj[idx] = mat_trans_vec(
+			    &frag->polarizable_pts[j].tensor,
+			    efp->indipconj + idx);
+		}
+	}
 error:
 	free(c);
 	free(ipiv);
 	return res;
 }
+
+/*
+ * With interaction cutoff only blocks of neighbor fragments are nonzero.
+ * Fragments are renumbered in reverse Cuthill-McKee order, which keeps
+ * neighbors close to each other, so all nonzero blocks fit into a narrow
+ * band around the diagonal. The band is factored with LAPACK band LU, which
+ * needs memory proportional to the number of points times the bandwidth
+ * instead of the square of the number of points.
+ */
+struct band {
+	/* new index of each polarizable point */
+	size_t *pt_idx;
+
+	/* number of sub- and super-diagonals */
+	size_t kl;
+};
+
+struct frag_degree {
+	size_t idx;
+	size_t degree;
+};
+
+static int
+cmp_frag_degree(const void *a, const void *b)
+{
+	const struct frag_degree *x = (const struct frag_degree *)a;
+	const struct frag_degree *y = (const struct frag_degree *)b;
+
+	if (x->degree != y->degree)
+		return x->degree < y->degree ? -1 : 1;
+
+	return x->idx < y->idx ? -1 : x->idx > y->idx;
+}
+
+static enum efp_result
+get_rcm_order(const struct efp *efp, size_t *order)
+{
+	size_t n = efp->n_frag, head = 0, tail = 0;
+	struct frag_degree *frags;
+	char *visited;
+
+	frags = (struct frag_degree *)malloc(n * sizeof(*frags));
+	visited = (char *)calloc(n, 1);
+
+	if (frags == NULL || visited == NULL) {
+		free(frags);
+		free(visited);
+		return EFP_RESULT_NO_MEMORY;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		frags[i].idx = i;
+		frags[i].degree = efp_get_nb_count(efp, i);
+	}
+	qsort(frags, n, sizeof(*frags), cmp_frag_degree);
+
+	/* breadth-first search from fragments with fewest neighbors */
+	for (size_t start = 0; start < n; start++) {
+		if (visited[frags[start].idx])
+			continue;
+
+		visited[frags[start].idx] = 1;
+		order[tail++] = frags[start].idx;
+
+		while (head < tail) {
+			size_t i = order[head++], first = tail;
+			size_t n_nb = efp_get_nb_count(efp, i);
+
+			for (size_t k = 0; k < n_nb; k++) {
+				size_t j = efp_get_nb(efp, i, k);
+
+				if (visited[j])
+					continue;
+
+				visited[j] = 1;
+				order[tail++] = j;
+			}
+
+			/* insertion sort of new fragments by degree */
+			for (size_t k = first + 1; k < tail; k++) {
+				size_t j = order[k], l = k;
+				size_t deg = efp_get_nb_count(efp, j);
+
+				for (; l > first &&
+				    efp_get_nb_count(efp, order[l - 1]) > deg;
+				    l--)
+					order[l] = order[l - 1];
+				order[l] = j;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < n / 2; i++) {
+		size_t t = order[i];
+
+		order[i] = order[n - 1 - i];
+		order[n - 1 - i] = t;
+	}
+
+	free(frags);
+	free(visited);
+	return EFP_RESULT_SUCCESS;
+}
+
+static enum efp_result
+setup_band(const struct efp *efp, struct band *band)
+{
+	size_t *order, kl = 0;
+	enum efp_result res;
+
+	band->pt_idx = (size_t *)malloc(efp->n_polarizable_pts *
+	    sizeof(size_t));
+	order = (size_t *)malloc(efp->n_frag * sizeof(size_t));
+
+	if (band->pt_idx == NULL || order == NULL) {
+		res = EFP_RESULT_NO_MEMORY;
+		goto error;
+	}
+	if ((res = get_rcm_order(efp, order)))
+		goto error;
+
+	for (size_t k = 0, idx = 0; k < efp->n_frag; k++) {
+		const struct frag *frag = efp->frags + order[k];
+
+		for (size_t j = 0; j < frag->n_polarizable_pts; j++)
+			band->pt_idx[frag->polarizable_offset + j] = idx++;
+	}
+
+	/* largest distance between rows and columns of nonzero blocks */
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		const struct frag *fr_i = efp->frags + i;
+		size_t n_nb = efp_get_nb_count(efp, i);
+
+		if (fr_i->n_polarizable_pts == 0)
+			continue;
+
+		size_t lo_i = band->pt_idx[fr_i->polarizable_offset];
+		size_t hi_i = lo_i + fr_i->n_polarizable_pts - 1;
+
+		for (size_t k = 0; k < n_nb; k++) {
+			const struct frag *fr_j = efp->frags +
+			    efp_get_nb(efp, i, k);
+
+			if (fr_j->n_polarizable_pts == 0)
+				continue;
+
+			size_t lo_j = band->pt_idx[fr_j->polarizable_offset];
+
+			if (lo_j < lo_i && hi_i - lo_j > kl)
+				kl = hi_i - lo_j;
+		}
+	}
+	band->kl = 3 * kl + 2;
+	res = EFP_RESULT_SUCCESS;
+error:
+	free(order);
+	return res;
+}
+
+static void
+copy_matrix_band(double *ab, const struct band *band, size_t off_i,
+    size_t off_j, const mat_t *m)
+{
+	size_t ldab = 3 * band->kl + 1;
+
+	for (size_t a = 0; a < 3; a++) {
+		for (size_t b = 0; b < 3; b++) {
+			size_t row = 3 * band->pt_idx[off_i] + a;
+			size_t col = 3 * band->pt_idx[off_j] + b;
+
+			ab[2 * band->kl + row - col + col * ldab] =
+			    mat_get(m, a, b);
+		}
+	}
+}
+
+/* 1 - A T in LAPACK band format with renumbered points */
+static void
+compute_lhs_band(const struct efp *efp, const struct band *band, double *ab)
+{
+	size_t n = 3 * efp->n_polarizable_pts;
+
+	memset(ab, 0, (3 * band->kl + 1) * n * sizeof(double));
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		const struct frag *fr_i = efp->frags + i;
+		size_t n_nb = efp_get_nb_count(efp, i);
+
+		for (size_t ii = 0; ii < fr_i->n_polarizable_pts; ii++) {
+			const struct polarizable_pt *pt_i =
+			    fr_i->polarizable_pts + ii;
+			size_t offset_i = fr_i->polarizable_offset + ii;
+
+			copy_matrix_band(ab, band, offset_i, offset_i,
+			    &mat_identity);
+
+			for (size_t k = 0; k < n_nb; k++) {
+				size_t j = efp_get_nb(efp, i, k);
+				const struct frag *fr_j = efp->frags + j;
+
+				for (size_t jj = 0;
+				    jj < fr_j->n_polarizable_pts; jj++) {
+					mat_t m = get_int_mat(efp, i, j,
+					    ii, jj);
+
+					m = mat_mat(&pt_i->tensor, &m);
+					mat_negate(&m);
+					copy_matrix_band(ab, band, offset_i,
+					    fr_j->polarizable_offset + jj, &m);
+				}
+			}
+		}
+	}
+}
+
+static enum efp_result
+compute_id_band(struct efp *efp, const struct band *band)
+{
+	size_t npts = efp->n_polarizable_pts, n = 3 * npts;
+	size_t ldab = 3 * band->kl + 1;
+	vec_t *id, *id_conj;
+	double *ab;
+	fortranint_t *ipiv;
+	enum efp_result res = EFP_RESULT_SUCCESS;
+
+	ab = (double *)malloc(ldab * n * sizeof *ab);
+	ipiv = (fortranint_t *)calloc(n, sizeof *ipiv);
+	id = (vec_t *)malloc(npts * sizeof *id);
+	id_conj = (vec_t *)malloc(npts * sizeof *id_conj);
+
+	if (ab == NULL || ipiv == NULL || id == NULL || id_conj == NULL) {
+		res = EFP_RESULT_NO_MEMORY;
+		goto error;
+	}
+
+	compute_lhs_band(efp, band, ab);
+	compute_rhs(efp, efp->indip, efp->indipconj);
+
+	for (size_t i = 0; i < npts; i++) {
+		id[band->pt_idx[i]] = efp->indip[i];
+		id_conj[band->pt_idx[i]] = efp->indipconj[i];
+	}
+
+	if (efp_dgbtrf((fortranint_t)n, (fortranint_t)n,
+	    (fortranint_t)band->kl, (fortranint_t)band->kl, ab,
+	    (fortranint_t)ldab, ipiv) != 0) {
+		efp_log("dgbtrf: error factoring polarization matrix");
+		res = EFP_RESULT_FATAL;
+		goto error;
+	}
+
+	/* induced dipoles */
+	if (efp_dgbtrs('N', (fortranint_t)n, (fortranint_t)band->kl,
+	    (fortranint_t)band->kl, 1, ab, (fortranint_t)ldab, ipiv,
+	    (double *)id, (fortranint_t)n) != 0) {
+		efp_log("dgbtrs: error solving for induced dipoles");
+		res = EFP_RESULT_FATAL;
+		goto error;
+	}
+
+	/* conjugate induced dipoles */
+	if (efp_dgbtrs('T', (fortranint_t)n, (fortranint_t)band->kl,
+	    (fortranint_t)band->kl, 1, ab, (fortranint_t)ldab, ipiv,
+	    (double *)id_conj, (fortranint_t)n) != 0) {
+		efp_log("dgbtrs: error solving for conjugate induced dipoles");
+		res = EFP_RESULT_FATAL;
+		goto error;
+	}
+
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		const struct frag *frag = efp->frags + i;
+
+		for (size_t j = 0; j < frag->n_polarizable_pts; j++) {
+			size_t idx = frag->polarizable_offset + j;
+
+			efp->indip[idx] = id[band->pt_idx[idx]];
+			efp->indipconj[idx] = mat_trans_vec(
+			    &frag->polarizable_pts[j].tensor,
+			    id_conj + band->pt_idx[idx]);
+		}
+	}
+error:
+	free(ab);
+	free(ipiv);
+	free(id);
+	free(id_conj);
+	return res;
+}
+
+enum efp_result
+efp_compute_id_direct(struct efp *efp)
+{
+	size_t n = 3 * efp->n_polarizable_pts;
+	int sym = is_symmetric(efp);
+
+	if (efp->opts.enable_cutoff) {
+		struct band band;
+		enum efp_result res;
+
+		if ((res = setup_band(efp, &band))) {
+			free(band.pt_idx);
+			return res;
+		}
+
+		/* use band storage if it is smaller than dense storage */
+		if ((3 * band.kl + 1) * (sym ? 2 : 1) < n) {
+			res = compute_id_band(efp, &band);
+			free(band.pt_idx);
+			return res;
+		}
+		free(band.pt_idx);
+	}
+
+	if (sym)
+		return compute_id_sym(efp);
+
+	return compute_id_lu(efp);
+}
@@ -29,9 +29,14 @@
 
 #include <assert.h>
 
+#ifdef EFP_USE_MPI
+#include <mpi.h>
+#endif
+
 #include "efp.h"
 #include "int.h"
 #include "log.h"
+#include "nblist.h"
 #include "swf.h"
 #include "terms.h"
 #include "util.h"
@@ -55,6 +60,21 @@ struct polarizable_pt {
 	vec_t elec_field_wf;
 };
 
+/* damped dipole field tensor between two polarizable points */
+struct dipole_tensor {
+	size_t idx;
+	double xx, yy, zz, xy, xz, yz;
+};
+
+/* parts of rotated fragment state which are updated only when a term that
+ * needs them is computed */
+enum frag_stale {
+	FRAG_STALE_XR_WF = 1 << 0,
+	FRAG_STALE_XR_WF_DERIV = 1 << 1,
+	FRAG_STALE_DISP_TENSORS = 1 << 2,
+	FRAG_STALE_ALL = (1 << 3) - 1
+};
+
 struct dynamic_polarizable_pt {
 	double x, y, z;
 	mat_t tensor[12];
@@ -83,6 +103,9 @@ struct frag {
 	/* pointer to the initial fragment state in library */
 	const struct frag *lib;
 
+	/* index of the fragment type in the library */
+	size_t lib_idx;
+
 	/* number of atoms in this fragment */
 	size_t n_atoms;
 
@@ -148,6 +171,79 @@ struct frag {
 
 	/* offset of polarizable points for this fragment */
 	size_t polarizable_offset;
+
+	/* frag_stale bits of state not updated after coordinates change */
+	unsigned stale;
+};
+
+/* two-body energies of a fragment pair */
+struct pair_energy {
+	double elec;
+	double disp;
+	double xr;
+	double cp;
+};
+
+/* induced dipoles exchanged with other processes if polarization is
+ * distributed, see efp_setup_halo */
+struct halo {
+	/* rank of this process */
+	int rank;
+
+	/* ranks of processes owning neighbors of owned fragments */
+	int *peers;
+
+	/* number of peer processes */
+	size_t n_peers;
+
+	/* owned fragments sent to peer k are send_frags[send_offset[k]]
+	 * to send_frags[send_offset[k + 1] - 1] */
+	size_t *send_offset;
+	size_t *send_frags;
+
+	/* fragments received from peer k in the same layout */
+	size_t *recv_offset;
+	size_t *recv_frags;
+
+	/* induced and conjugate induced dipoles of all points of sent and
+	 * received fragments */
+	double *send_buf;
+	double *recv_buf;
+};
+
+/* per-thread scratch memory for computations on fragment pairs */
+struct workspace {
+	/* overlap integrals between LMOs and their derivatives */
+	double *lmo_s;
+	six_t *lmo_ds;
+
+	/* exchange repulsion integrals over basis functions */
+	double *s;
+	double *t;
+
+	/* exchange repulsion temporaries */
+	double *lmo_t;
+	double *tmp;
+	struct xr_atom *atoms_j;
+
+	/* exchange repulsion gradient temporaries, allocated only if
+	 * gradient is requested */
+	six_t *ds;
+	six_t *dt;
+	six_t *lmo_dt;
+	six_t *sixtmp;
+	double *lmo_tmp;
+
+	/* thread-private gradient accumulators which are added to the
+	 * totals after each term, allocated only if gradient is requested;
+	 * stress is NULL if stress tensor computation is disabled */
+	six_t *grad;
+	vec_t *ptc_grad;
+	mat_t *stress;
+
+	/* thread-private static electric field accumulators, one per
+	 * polarizable point */
+	vec_t *field;
 };
 
 struct efp {
@@ -163,6 +259,16 @@ struct efp {
 	/* array with the library of fragment initial parameters */
 	struct frag **lib;
 
+	/* number of fragment types in dispersion coefficient tables */
+	size_t n_disp_lib;
+
+	/* offsets into disp_c6 for each pair of fragment types */
+	size_t *disp_c6_offset;
+
+	/* sums over frequencies of products of isotropic dynamic
+	 * polarizabilities for all pairs of dynamic polarizable points */
+	double *disp_c6;
+
 	/* callback which computes electric field from electrons */
 	efp_electron_density_field_fn get_electron_density_field;
 
@@ -227,6 +333,122 @@ struct efp {
 
 	/* skip-list of fragments - boolean array of nfrag^2 elements */
 	char *skiplist;
+
+	/* offsets of fragment neighbor lists in nb_frags, size n_frag + 1 */
+	size_t *nb_offset;
+
+	/* fragment neighbor lists, used if interaction cutoff is enabled */
+	size_t *nb_frags;
+
+	/* allocated size of nb_frags array */
+	size_t nb_size;
+
+	/* offsets of owned pairs of each fragment in pair_frags,
+	 * size n_frag + 1 */
+	size_t *pair_offset;
+
+	/* second fragments of owned pairs, used if interaction cutoff is
+	 * enabled */
+	size_t *pair_frags;
+
+	/* allocated size of pair_frags array */
+	size_t pair_size;
+
+	/* fragment centers at the time of the last neighbor list update */
+	vec_t *nb_xyz;
+
+	/* neighbor lists must be rebuilt if nonzero */
+	int nb_stale;
+
+	/* per-thread scratch memory */
+	struct workspace *ws;
+
+	/* number of allocated workspaces */
+	size_t n_ws;
+
+	/* nonzero if workspaces contain gradient buffers */
+	int ws_grad;
+
+	/* estimated relative cost of work for each fragment */
+	double *frag_cost;
+
+	/* time spent on two-body terms of each fragment in last compute */
+	double *frag_time;
+
+	/* nonzero if fragment costs come from measured timings */
+	int cost_measured;
+
+	/* energies of owned pairs from the last computation, used if
+	 * incremental computation is enabled */
+	struct pair_energy *pair_cache;
+
+	/* allocated size of pair_cache array */
+	size_t pair_cache_size;
+
+	/* sum of energies in pair_cache */
+	struct pair_energy pair_total;
+
+	/* nonzero if pair_cache matches current fragment pairs */
+	int pair_cache_valid;
+
+	/* nonzero for fragments moved since the last computation */
+	char *frag_dirty;
+
+	/* indices of moved fragments */
+	size_t *dirty_frags;
+
+	/* number of moved fragments */
+	size_t n_dirty;
+
+	/* offsets into pol_tensors for each polarizable point */
+	size_t *pol_offset;
+
+	/* dipole field tensors from other polarizable points */
+	struct dipole_tensor *pol_tensors;
+
+	/* allocated size of pol_tensors array */
+	size_t pol_size;
+
+	/* nonzero for fragments with computed pol_tensors */
+	char *pol_built;
+
+	/* previous induced dipoles and conjugate induced dipoles, newest
+	 * first */
+	vec_t *pol_hist;
+
+	/* number of stored solutions in pol_hist */
+	size_t n_pol_hist;
+
+	/* dipole pairs for gradient of perturbative polarization, see
+	 * efp_compute_id_opt */
+	vec_t *pol_opt;
+
+	/* nonzero if polarizable points are split between processes during
+	 * iterative solution of polarization equations */
+	int dist_pol;
+
+	/* nonzero if fragment partition and halo need to be rebuilt */
+	int halo_stale;
+
+	/* process owning each fragment if dist_pol is set */
+	int *frag_owner;
+
+	/* fragments owned by this process */
+	size_t *own_frags;
+
+	/* number of fragments owned by this process */
+	size_t n_own_frags;
+
+	/* exchange of induced dipoles with other processes */
+	struct halo halo;
+
+#ifdef EFP_USE_MPI
+	/* communicator used to distribute work */
+	MPI_Comm mpi_comm;
+
+	/* window with next unclaimed fragment for work stealing */
+	MPI_Win steal_win;
+#endif
 };
 
 #endif /* LIBEFP_PRIVATE_H */
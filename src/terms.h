@@ -31,19 +31,23 @@
 
 struct efp;
 struct frag;
+struct swf;
 
-double efp_frag_frag_elec(struct efp *, size_t, size_t);
-double efp_frag_frag_disp(struct efp *, size_t, size_t,
+double efp_frag_frag_elec(struct efp *, size_t, size_t, const struct swf *);
+double efp_frag_frag_disp(struct efp *, size_t, size_t, const struct swf *,
     const double *, const six_t *);
-void efp_frag_frag_xr(struct efp *, size_t, size_t, double *,
-    six_t *, double *, double *);
+void efp_frag_frag_xr(struct efp *, size_t, size_t, const struct swf *,
+    double *, six_t *, double *, double *);
 enum efp_result efp_compute_pol(struct efp *);
 enum efp_result efp_compute_ai_elec(struct efp *);
 enum efp_result efp_compute_ai_disp(struct efp *);
 enum efp_result efp_compute_pol_energy(struct efp *, double *);
+enum efp_result efp_setup_disp(struct efp *);
 void efp_update_elec(struct frag *);
 void efp_update_pol(struct frag *);
 void efp_update_disp(struct frag *);
+void efp_update_disp_tensors(struct frag *);
 void efp_update_xr(struct frag *);
+void efp_update_xr_wf(struct frag *, int, int);
 
 #endif /* LIBEFP_TERMS_H */
@@ -26,6 +26,10 @@
 
 #include <ctype.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "private.h"
 #include "util.h"
 
@@ -155,25 +159,85 @@ efp_find_lib(struct efp *efp, const char *name)
 	return NULL;
 }
 
+struct workspace *
+efp_get_workspace(const struct efp *efp)
+{
+	size_t idx = 0;
+
+#ifdef _OPENMP
+	/* work can run in a nested region of an outer parallel region, so
+	 * thread number in the outermost region is used */
+	if (omp_get_level() > 0)
+		idx = (size_t)omp_get_ancestor_thread_num(1);
+#endif
+	assert(idx < efp->n_ws);
+	return efp->ws + idx;
+}
+
+/* adds workspace gradient and stress accumulators to the totals and
+ * clears them for the next term */
 void
-efp_add_stress(const vec_t *dr, const vec_t *force, mat_t *stress)
+efp_reduce_gradient(struct efp *efp)
 {
+	if (!efp->do_gradient)
+		return;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+	for (size_t i = 0; i < efp->n_frag; i++) {
+		for (size_t k = 0; k < efp->n_ws; k++) {
+			six_t *grad = efp->ws[k].grad + i;
+
+			six_add_xyz(efp->grad + i, (vec_t *)grad);
+			six_add_abc(efp->grad + i, ((vec_t *)grad) + 1);
+			memset(grad, 0, sizeof(six_t));
+		}
+	}
+
 #ifdef _OPENMP
-#pragma omp critical
+#pragma omp parallel for schedule(static)
 #endif
-	{
-		stress->xx += dr->x * force->x;
-		stress->xy += dr->x * force->y;
-		stress->xz += dr->x * force->z;
-		stress->yx += dr->y * force->x;
-		stress->yy += dr->y * force->y;
-		stress->yz += dr->y * force->z;
-		stress->zx += dr->z * force->x;
-		stress->zy += dr->z * force->y;
-		stress->zz += dr->z * force->z;
+	for (size_t i = 0; i < efp->n_ptc; i++) {
+		for (size_t k = 0; k < efp->n_ws; k++) {
+			vec_t *grad = efp->ws[k].ptc_grad + i;
+
+			efp->ptc_grad[i] = vec_add(efp->ptc_grad + i, grad);
+			*grad = vec_zero;
+		}
+	}
+
+	for (size_t k = 0; k < efp->n_ws; k++) {
+		mat_t *stress = efp->ws[k].stress;
+
+		if (stress == NULL)
+			continue;
+
+		for (size_t a = 0; a < 9; a++)
+			((double *)&efp->stress)[a] += ((double *)stress)[a];
+
+		memset(stress, 0, sizeof(mat_t));
 	}
 }
 
+/* stress is NULL if its computation is disabled */
+void
+efp_add_stress(const vec_t *dr, const vec_t *force, mat_t *stress)
+{
+	if (stress == NULL)
+		return;
+
+	stress->xx += dr->x * force->x;
+	stress->xy += dr->x * force->y;
+	stress->xz += dr->x * force->z;
+	stress->yx += dr->y * force->x;
+	stress->yy += dr->y * force->y;
+	stress->yz += dr->y * force->z;
+	stress->zx += dr->z * force->x;
+	stress->zy += dr->z * force->y;
+	stress->zz += dr->z * force->z;
+}
+
 void
 efp_add_force(six_t *grad, const vec_t *com, const vec_t *pt,
     const vec_t *force, const vec_t *add)
@@ -186,8 +250,8 @@ efp_add_force(six_t *grad, const vec_t *com, const vec_t *pt,
 		torque.y += add->y;
 		torque.z += add->z;
 	}
-	six_atomic_add_xyz(grad, force);
-	six_atomic_add_abc(grad, &torque);
+	six_add_xyz(grad, force);
+	six_add_abc(grad, &torque);
 }
 
 void
@@ -202,8 +266,8 @@ efp_sub_force(six_t *grad, const vec_t *com, const vec_t *pt,
 		torque.y += add->y;
 		torque.z += add->z;
 	}
-	six_atomic_sub_xyz(grad, force);
-	six_atomic_sub_abc(grad, &torque);
+	six_sub_xyz(grad, force);
+	six_sub_abc(grad, &torque);
 }
 
 void
@@ -219,38 +283,54 @@ efp_move_pt(const vec_t *com, const mat_t *rotmat,
 void
 efp_rotate_t2(const mat_t *rotmat, const double *in, double *out)
 {
-	for (size_t i = 0; i < 3 * 3; i++)
-		out[i] = 0.0;
+	double tmp[9];
+
+	/* out = R * in * R^T */
+	for (size_t a2 = 0; a2 < 3; a2++)
+		for (size_t b1 = 0; b1 < 3; b1++)
+			tmp[a2 * 3 + b1] =
+			    mat_get(rotmat, a2, 0) * in[0 * 3 + b1] +
+			    mat_get(rotmat, a2, 1) * in[1 * 3 + b1] +
+			    mat_get(rotmat, a2, 2) * in[2 * 3 + b1];
 
-	for (size_t a1 = 0; a1 < 3; a1++)
-	for (size_t b1 = 0; b1 < 3; b1++)
-		for (size_t a2 = 0; a2 < 3; a2++)
+	for (size_t a2 = 0; a2 < 3; a2++)
 		for (size_t b2 = 0; b2 < 3; b2++)
-			out[a2 * 3 + b2] += in[a1 * 3 + b1] *
-			    mat_get(rotmat, a2, a1) *
-			    mat_get(rotmat, b2, b1);
+			out[a2 * 3 + b2] =
+			    tmp[a2 * 3 + 0] * mat_get(rotmat, b2, 0) +
+			    tmp[a2 * 3 + 1] * mat_get(rotmat, b2, 1) +
+			    tmp[a2 * 3 + 2] * mat_get(rotmat, b2, 2);
 }
 
 void
 efp_rotate_t3(const mat_t *rotmat, const double *in, double *out)
 {
-	double a, b, c;
+	double tmp1[27], tmp2[27];
 
-	for (size_t i = 0; i < 3 * 3 * 3; i++)
-		out[i] = 0.0;
+	/* contract one index at a time */
+	for (size_t a2 = 0; a2 < 3; a2++)
+		for (size_t bc = 0; bc < 9; bc++)
+			tmp1[a2 * 9 + bc] =
+			    mat_get(rotmat, a2, 0) * in[0 * 9 + bc] +
+			    mat_get(rotmat, a2, 1) * in[1 * 9 + bc] +
+			    mat_get(rotmat, a2, 2) * in[2 * 9 + bc];
+
+	for (size_t a2 = 0; a2 < 3; a2++) {
+		const double *t = tmp1 + a2 * 9;
 
-	for (size_t a1 = 0; a1 < 3; a1++)
-	for (size_t b1 = 0; b1 < 3; b1++)
-	for (size_t c1 = 0; c1 < 3; c1++)
-		for (size_t a2 = 0; a2 < 3; a2++)
 		for (size_t b2 = 0; b2 < 3; b2++)
-		for (size_t c2 = 0; c2 < 3; c2++) {
-			a = mat_get(rotmat, a2, a1);
-			b = mat_get(rotmat, b2, b1);
-			c = mat_get(rotmat, c2, c1);
-			out[a2 * 9 + b2 * 3 + c2] +=
-			    in[a1 * 9 + b1 * 3 + c1] * a * b * c;
-		}
+			for (size_t c1 = 0; c1 < 3; c1++)
+				tmp2[a2 * 9 + b2 * 3 + c1] =
+				    mat_get(rotmat, b2, 0) * t[0 * 3 + c1] +
+				    mat_get(rotmat, b2, 1) * t[1 * 3 + c1] +
+				    mat_get(rotmat, b2, 2) * t[2 * 3 + c1];
+	}
+
+	for (size_t ab = 0; ab < 9; ab++)
+		for (size_t c2 = 0; c2 < 3; c2++)
+			out[ab * 3 + c2] =
+			    mat_get(rotmat, c2, 0) * tmp2[ab * 3 + 0] +
+			    mat_get(rotmat, c2, 1) * tmp2[ab * 3 + 1] +
+			    mat_get(rotmat, c2, 2) * tmp2[ab * 3 + 2];
 }
 
 int
@@ -31,6 +31,7 @@
 
 struct efp;
 struct frag;
+struct workspace;
 
 int efp_skip_frag_pair(const struct efp *, size_t, size_t);
 struct swf efp_make_swf(const struct efp *, const struct frag *,
@@ -38,6 +39,8 @@ struct swf efp_make_swf(const struct efp *, const struct frag *,
 int efp_check_rotation_matrix(const mat_t *);
 void efp_points_to_matrix(const double *, mat_t *);
 const struct frag *efp_find_lib(struct efp *, const char *);
+struct workspace *efp_get_workspace(const struct efp *);
+void efp_reduce_gradient(struct efp *);
 void efp_add_stress(const vec_t *, const vec_t *, mat_t *);
 void efp_add_force(six_t *, const vec_t *, const vec_t *,
     const vec_t *, const vec_t *);
@@ -31,6 +31,7 @@
 #include "private.h"
 
 #define INTEGRAL_THRESHOLD 1.0e-7
+#define XR_INT_TOL 1.0e-20
 
 static inline size_t
 fock_idx(size_t i, size_t j)
@@ -59,6 +60,7 @@ charge_penetration_grad(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
 	if (fabs(s_ij) < INTEGRAL_THRESHOLD)
 		return;
 
+	struct workspace *ws = efp_get_workspace(efp);
 	const struct frag *fr_i = efp->frags + fr_i_idx;
 	const struct frag *fr_j = efp->frags + fr_j_idx;
 	const vec_t *ct_i = fr_i->lmo_centroids + lmo_i_idx;
@@ -96,12 +98,21 @@ charge_penetration_grad(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
 	torque_j.z = torque_i.z + force.x * (fr_j->y - fr_i->y - swf->cell.y) -
 				  force.y * (fr_j->x - fr_i->x - swf->cell.x);
 
-	six_atomic_add_xyz(efp->grad + fr_i_idx, &force);
-	six_atomic_sub_xyz(efp->grad + fr_j_idx, &force);
-	six_atomic_add_abc(efp->grad + fr_i_idx, &torque_i);
-	six_atomic_sub_abc(efp->grad + fr_j_idx, &torque_j);
+	six_add_xyz(ws->grad + fr_i_idx, &force);
+	six_sub_xyz(ws->grad + fr_j_idx, &force);
+	six_add_abc(ws->grad + fr_i_idx, &torque_i);
+	six_sub_abc(ws->grad + fr_j_idx, &torque_j);
 
-	efp_add_stress(&swf->dr, &force, &efp->stress);
+	efp_add_stress(&swf->dr, &force, ws->stress);
+}
+
+static double
+get_xr_int_tol(const struct efp *efp)
+{
+	if (efp->opts.xr_int_tol > 0.0)
+		return efp->opts.xr_int_tol;
+
+	return XR_INT_TOL;
 }
 
 static void
@@ -188,6 +199,7 @@ lmo_lmo_xr_grad(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
     size_t i, size_t j, const double *lmo_s, const double *lmo_t,
     const six_t *lmo_ds, const six_t *lmo_dt, const struct swf *swf)
 {
+	struct workspace *ws = efp_get_workspace(efp);
 	const struct frag *fr_i = efp->frags + fr_i_idx;
 	const struct frag *fr_j = efp->frags + fr_j_idx;
 	const vec_t *ct_i = fr_i->lmo_centroids + i;
@@ -415,12 +427,12 @@ lmo_lmo_xr_grad(struct efp *efp, size_t fr_i_idx, size_t fr_j_idx,
 		    force.y * (fr_j->x - fr_i->x - swf->cell.x)
 	};
 
-	six_atomic_add_xyz(efp->grad + fr_i_idx, &force);
-	six_atomic_sub_xyz(efp->grad + fr_j_idx, &force);
-	six_atomic_add_abc(efp->grad + fr_i_idx, &torque_i);
-	six_atomic_sub_abc(efp->grad + fr_j_idx, &torque_j);
+	six_add_xyz(ws->grad + fr_i_idx, &force);
+	six_sub_xyz(ws->grad + fr_j_idx, &force);
+	six_add_abc(ws->grad + fr_i_idx, &torque_i);
+	six_sub_abc(ws->grad + fr_j_idx, &torque_j);
 
-	efp_add_stress(&swf->dr, &force, &efp->stress);
+	efp_add_stress(&swf->dr, &force, ws->stress);
 }
 
 static double
@@ -515,33 +527,38 @@ lmo_lmo_xr_energy(struct frag *fr_i, struct frag *fr_j, size_t i, size_t j,
 }
 
 void
-efp_frag_frag_xr(struct efp *efp, size_t frag_i, size_t frag_j, double *lmo_s,
-    six_t *lmo_ds, double *exr_out, double *ecp_out)
+efp_frag_frag_xr(struct efp *efp, size_t frag_i, size_t frag_j,
+    const struct swf *swf, double *lmo_s, six_t *lmo_ds, double *exr_out,
+    double *ecp_out)
 {
 	struct frag *fr_i = efp->frags + frag_i;
 	struct frag *fr_j = efp->frags + frag_j;
 
-	size_t ij_wf_size = fr_i->xr_wf_size * fr_j->xr_wf_size;
-	size_t ij_nlmo = fr_i->n_lmo * fr_j->n_lmo;
-	size_t ij_nlmo_wf_size = fr_i->n_lmo * fr_j->xr_wf_size;
-	double *s = (double *)malloc(ij_wf_size * sizeof(double));
-	double *t = (double *)malloc(ij_wf_size * sizeof(double));
-	double *lmo_t = (double *)malloc(ij_nlmo * sizeof(double));
-	double *tmp = (double *)malloc(ij_nlmo_wf_size * sizeof(double));
-	struct xr_atom *atoms_j = (struct xr_atom *)malloc(
-	    fr_j->n_xr_atoms * sizeof(struct xr_atom));
-	struct swf swf = efp_make_swf(efp, fr_i, fr_j);
+	struct workspace *ws = efp_get_workspace(efp);
+	double *s = ws->s;
+	double *t = ws->t;
+	double *lmo_t = ws->lmo_t;
+	double *tmp = ws->tmp;
+	struct xr_atom *atoms_j = ws->atoms_j;
 
 	for (size_t j = 0; j < fr_j->n_xr_atoms; j++) {
 		atoms_j[j] = fr_j->xr_atoms[j];
-		atoms_j[j].x -= swf.cell.x;
-		atoms_j[j].y -= swf.cell.y;
-		atoms_j[j].z -= swf.cell.z;
+		atoms_j[j].x -= swf->cell.x;
+		atoms_j[j].y -= swf->cell.y;
+		atoms_j[j].z -= swf->cell.z;
 	}
 
-	efp_st_int(fr_i->n_xr_atoms, fr_i->xr_atoms,
-		   fr_j->n_xr_atoms, atoms_j,
-		   fr_j->xr_wf_size, s, t);
+	/* derivatives share recurrence intermediates with integrals */
+	if (efp->do_gradient)
+		efp_st_int_deriv(fr_i->n_xr_atoms, fr_i->xr_atoms,
+				 fr_j->n_xr_atoms, atoms_j,
+				 VEC(fr_i->x), fr_i->xr_wf_size,
+				 fr_j->xr_wf_size, get_xr_int_tol(efp),
+				 s, t, ws->ds, ws->dt);
+	else
+		efp_st_int(fr_i->n_xr_atoms, fr_i->xr_atoms,
+			   fr_j->n_xr_atoms, atoms_j,
+			   fr_j->xr_wf_size, get_xr_int_tol(efp), s, t);
 
 	transform_integrals(fr_i->n_lmo, fr_j->n_lmo,
 			    fr_i->xr_wf_size, fr_j->xr_wf_size,
@@ -561,11 +578,11 @@ efp_frag_frag_xr(struct efp *efp, size_t frag_i, size_t frag_j, double *lmo_s,
 
 			vec_t dr = {
 				fr_j->lmo_centroids[j].x -
-				    fr_i->lmo_centroids[i].x - swf.cell.x,
+				    fr_i->lmo_centroids[i].x - swf->cell.x,
 				fr_j->lmo_centroids[j].y -
-				    fr_i->lmo_centroids[i].y - swf.cell.y,
+				    fr_i->lmo_centroids[i].y - swf->cell.y,
 				fr_j->lmo_centroids[j].z -
-				    fr_i->lmo_centroids[i].z - swf.cell.z
+				    fr_i->lmo_centroids[i].z - swf->cell.z
 			};
 
 			double r_ij = vec_len(&dr);
@@ -575,34 +592,23 @@ efp_frag_frag_xr(struct efp *efp, size_t frag_i, size_t frag_j, double *lmo_s,
 				ecp += charge_penetration_energy(s_ij, r_ij);
 			if (efp->opts.terms & EFP_TERM_XR)
 				exr += lmo_lmo_xr_energy(fr_i, fr_j, i, j,
-				    lmo_s, lmo_t, &swf);
+				    lmo_s, lmo_t, swf);
 		}
 	}
 
-	*exr_out = exr * swf.swf;
-	*ecp_out = ecp * swf.swf;
+	*exr_out = exr;
+	*ecp_out = ecp;
 
-	if (!efp->do_gradient) {
-		free(s);
-		free(t);
-		free(lmo_t);
-		free(tmp);
-		free(atoms_j);
+	if (!efp->do_gradient)
 		return;
-	}
 
 	/* compute gradient */
 
-	six_t *ds = (six_t *)malloc(ij_wf_size * sizeof(six_t));
-	six_t *dt = (six_t *)malloc(ij_wf_size * sizeof(six_t));
-	six_t *lmo_dt = (six_t *)malloc(ij_nlmo * sizeof(six_t));
-	six_t *sixtmp = (six_t *)malloc(ij_nlmo_wf_size * sizeof(six_t));
-	double *lmo_tmp = (double *)malloc(ij_nlmo * sizeof(double));
-
-	efp_st_int_deriv(fr_i->n_xr_atoms, fr_i->xr_atoms,
-			 fr_j->n_xr_atoms, atoms_j,
-			 VEC(fr_i->x), fr_i->xr_wf_size, fr_j->xr_wf_size,
-			 ds, dt);
+	six_t *ds = ws->ds;
+	six_t *dt = ws->dt;
+	six_t *lmo_dt = ws->lmo_dt;
+	six_t *sixtmp = ws->sixtmp;
+	double *lmo_tmp = ws->lmo_tmp;
 
 	transform_integral_derivatives(fr_i->n_lmo, fr_j->n_lmo,
 				       fr_i->xr_wf_size, fr_j->xr_wf_size,
@@ -634,33 +640,12 @@ efp_frag_frag_xr(struct efp *efp, size_t frag_i, size_t frag_j, double *lmo_s,
 			if ((efp->opts.terms & EFP_TERM_ELEC) &&
 			    (efp->opts.elec_damp == EFP_ELEC_DAMP_OVERLAP))
 				charge_penetration_grad(efp, frag_i, frag_j,
-				    i, j, lmo_s[ij], lmo_ds[ij], &swf);
+				    i, j, lmo_s[ij], lmo_ds[ij], swf);
 			if (efp->opts.terms & EFP_TERM_XR)
 				lmo_lmo_xr_grad(efp, frag_i, frag_j, i, j,
-				    lmo_s, lmo_t, lmo_ds, lmo_dt, &swf);
+				    lmo_s, lmo_t, lmo_ds, lmo_dt, swf);
 		}
 	}
-
-	vec_t force = {
-		swf.dswf.x * (exr + ecp),
-		swf.dswf.y * (exr + ecp),
-		swf.dswf.z * (exr + ecp)
-	};
-
-	six_atomic_add_xyz(efp->grad + frag_i, &force);
-	six_atomic_sub_xyz(efp->grad + frag_j, &force);
-	efp_add_stress(&swf.dr, &force, &efp->stress);
-
-	free(s);
-	free(ds);
-	free(t);
-	free(dt);
-	free(lmo_t);
-	free(lmo_dt);
-	free(lmo_tmp);
-	free(tmp);
-	free(sixtmp);
-	free(atoms_j);
 }
 
 static inline size_t
@@ -874,15 +859,98 @@ efp_update_xr(struct frag *frag)
 		efp_move_pt(CVEC(frag->x), rotmat,
 		    CVEC(frag->lib->xr_atoms[i].x), VEC(frag->xr_atoms[i].x));
 	}
-	/* rotate wavefunction */
+}
+
+static void
+rotate_func_p(const mat_t *rotmat, const double *in, double *out)
+{
+	vec_t r = mat_vec(rotmat, (const vec_t *)in);
+
+	out[0] = r.x;
+	out[1] = r.y;
+	out[2] = r.z;
+}
+
+/* column-major matrix of a shell rotation obtained from unit vectors */
+static void
+setup_shell_rotation(const mat_t *rotmat, size_t n,
+    void (*rotate)(const mat_t *, const double *, double *), double *m)
+{
+	double unit[10];
+
+	for (size_t i = 0; i < n; i++) {
+		memset(unit, 0, n * sizeof(double));
+		unit[i] = 1.0;
+		rotate(rotmat, unit, m + i * n);
+	}
+}
+
+/* rotates shell coefficients of all LMOs with one matrix product */
+static void
+rotate_shell(size_t n, const double *m, size_t n_lmo, size_t wf_size,
+    const double *in, double *out)
+{
+	efp_dgemm('N', 'N', (fortranint_t)n, (fortranint_t)n_lmo,
+	    (fortranint_t)n, 1.0, (double *)m, (fortranint_t)n, (double *)in,
+	    (fortranint_t)wf_size, 0.0, out, (fortranint_t)wf_size);
+}
+
+static void
+rotate_wf(struct frag *frag)
+{
+	double m_p[3 * 3], m_d[6 * 6], m_f[10 * 10];
+
+	if (frag->n_lmo == 0)
+		return;
+
+	setup_shell_rotation(&frag->rotmat, 3, rotate_func_p, m_p);
+	setup_shell_rotation(&frag->rotmat, 6, rotate_func_d, m_d);
+	setup_shell_rotation(&frag->rotmat, 10, rotate_func_f, m_f);
+
+	const double *in = frag->lib->xr_wf;
+	double *out = frag->xr_wf;
+
+	for (size_t j = 0, func = 0; j < frag->n_xr_atoms; j++) {
+		const struct xr_atom *atom = frag->xr_atoms + j;
+
+		for (size_t i = 0; i < atom->n_shells; i++) {
+			switch (atom->shells[i].type) {
+			case 'S':
+				func++;
+				break;
+			case 'L':
+				func++;
+				/* fall through */
+			case 'P':
+				rotate_shell(3, m_p, frag->n_lmo,
+				    frag->xr_wf_size, in + func, out + func);
+				func += 3;
+				break;
+			case 'D':
+				rotate_shell(6, m_d, frag->n_lmo,
+				    frag->xr_wf_size, in + func, out + func);
+				func += 6;
+				break;
+			case 'F':
+				rotate_shell(10, m_f, frag->n_lmo,
+				    frag->xr_wf_size, in + func, out + func);
+				func += 10;
+				break;
+			}
+		}
+	}
+}
+
+static void
+update_wf_deriv(struct frag *frag)
+{
 	for (size_t k = 0; k < frag->n_lmo; k++) {
 		double *deriv[3];
 
 		for (size_t a = 0; a < 3; a++)
 			deriv[a] = frag->xr_wf_deriv[a] + k * frag->xr_wf_size;
 
-		const double *in = frag->lib->xr_wf + k * frag->xr_wf_size;
-		double *out = frag->xr_wf + k * frag->xr_wf_size;
+		const double *wf = frag->xr_wf + k * frag->xr_wf_size;
 
 		for (size_t j = 0, func = 0; j < frag->n_xr_atoms; j++) {
 			const struct xr_atom *atom = frag->xr_atoms + j;
@@ -895,35 +963,22 @@ efp_update_xr(struct frag *frag)
 				case 'L':
 					func++;
 					/* fall through */
-				case 'P': {
-					vec_t r = mat_vec(rotmat,
-					    (const vec_t *)(in + func));
-					out[func + 0] = r.x;
-					out[func + 1] = r.y;
-					out[func + 2] = r.z;
-					for (size_t a = 0; a < 3; a++) {
-						coef_deriv_p(a, out + func,
+				case 'P':
+					for (size_t a = 0; a < 3; a++)
+						coef_deriv_p(a, wf + func,
 						    deriv[a] + func);
-					}
 					func += 3;
 					break;
-				}
 				case 'D':
-					rotate_func_d(rotmat, in + func,
-					    out + func);
-					for (size_t a = 0; a < 3; a++) {
-						coef_deriv_d(a, out + func,
+					for (size_t a = 0; a < 3; a++)
+						coef_deriv_d(a, wf + func,
 						    deriv[a] + func);
-					}
 					func += 6;
 					break;
 				case 'F':
-					rotate_func_f(rotmat, in + func,
-					    out + func);
-					for (size_t a = 0; a < 3; a++) {
-						coef_deriv_f(a, out + func,
+					for (size_t a = 0; a < 3; a++)
+						coef_deriv_f(a, wf + func,
 						    deriv[a] + func);
-					}
 					func += 10;
 					break;
 				}
@@ -931,3 +986,14 @@ efp_update_xr(struct frag *frag)
 		}
 	}
 }
+
+/* rotates wavefunction if do_rotate is nonzero and computes rotational
+ * derivatives of its coefficients if do_deriv is nonzero */
+void
+efp_update_xr_wf(struct frag *frag, int do_rotate, int do_deriv)
+{
+	if (do_rotate)
+		rotate_wf(frag);
+	if (do_deriv)
+		update_wf_deriv(frag);
+}
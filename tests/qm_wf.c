@@ -0,0 +1,165 @@
+/*-
+ * Copyright (c) 2012-2017 Ilya Kaliman
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+
+/* Checks that the wavefunction-dependent energy stays consistent with
+ * efp_compute after the number of point charges, the stress option or the
+ * number of threads change between calls. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <efp.h>
+
+#define BOHR_RADIUS 0.52917721092
+#define TOLERANCE 1.0e-7
+
+/* fragments are replicated along x to give every thread some work */
+#define N_COPIES 4
+#define COPY_SHIFT 12.0
+
+static const char *frag_names[] = { "h2o_L", "c6h6_L", "nh3_L" };
+
+static const double frag_xyzabc[] = {
+	-1.6,  4.7,  1.4, -1.3, 0.1,  7.0,
+	 0.4, -0.9, -0.7,  2.3, 1.6, -2.3,
+	-3.5, -2.0, -0.7,  0.0, 2.2,  2.7,
+};
+
+static const double ptc[] = { 1.0, 8.0, 2.0, 1.0 };
+
+static const double ptc_xyz[] = {
+	 3.2,  1.8, -2.3,
+	-2.9, -6.2, -2.5,
+	 5.0,  4.3,  0.2,
+	 4.9,  0.0,  4.7,
+};
+
+static void
+check(enum efp_result res)
+{
+	if (res) {
+		fprintf(stderr, "LIBEFP: %s\n", efp_result_to_string(res));
+		printf("FAILURE: qm_wf\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+set_point_charges(struct efp *efp, size_t n_ptc)
+{
+	double xyz[3 * 4];
+
+	for (size_t i = 0; i < 3 * n_ptc; i++)
+		xyz[i] = ptc_xyz[i] / BOHR_RADIUS;
+
+	check(efp_set_point_charges(efp, n_ptc, ptc, xyz));
+}
+
+/* compares the wavefunction-dependent energy with the full computation */
+static int
+test_energy(struct efp *efp, const char *label)
+{
+	struct efp_energy energy;
+	double wf_energy;
+
+	check(efp_get_wavefunction_dependent_energy(efp, &wf_energy));
+	check(efp_compute(efp, 1));
+	check(efp_get_energy(efp, &energy));
+
+	if (fabs(wf_energy - energy.polarization) > TOLERANCE) {
+		printf("%s: %.10lf DOES NOT MATCH %.10lf\n", label, wf_energy,
+		    energy.polarization);
+		return 1;
+	}
+	return 0;
+}
+
+int
+main(void)
+{
+	struct efp *efp;
+	struct efp_opts opts;
+	size_t n_frag = sizeof(frag_names) / sizeof(*frag_names);
+	double coord[N_COPIES * sizeof(frag_xyzabc) / sizeof(double)];
+	int fail = 0;
+
+	efp = efp_create();
+	efp_opts_default(&opts);
+	opts.terms = EFP_TERM_ELEC | EFP_TERM_POL | EFP_TERM_AI_ELEC |
+	    EFP_TERM_AI_POL;
+	check(efp_set_opts(efp, &opts));
+
+	check(efp_add_potential(efp, "../fraglib/h2o.efp"));
+	check(efp_add_potential(efp, "../fraglib/c6h6.efp"));
+	check(efp_add_potential(efp, "../fraglib/nh3.efp"));
+
+	for (size_t k = 0; k < N_COPIES; k++)
+		for (size_t i = 0; i < n_frag; i++)
+			check(efp_add_fragment(efp, frag_names[i]));
+
+	check(efp_prepare(efp));
+
+	for (size_t k = 0; k < N_COPIES; k++) {
+		for (size_t i = 0; i < n_frag; i++) {
+			const double *src = frag_xyzabc + 6 * i;
+			double *dst = coord + 6 * (k * n_frag + i);
+
+			dst[0] = (src[0] + k * COPY_SHIFT) / BOHR_RADIUS;
+			dst[1] = src[1] / BOHR_RADIUS;
+			dst[2] = src[2] / BOHR_RADIUS;
+			dst[3] = src[3];
+			dst[4] = src[4];
+			dst[5] = src[5];
+		}
+	}
+
+	check(efp_set_coordinates(efp, EFP_COORD_TYPE_XYZABC, coord));
+
+	set_point_charges(efp, 2);
+	check(efp_compute(efp, 1));
+
+	set_point_charges(efp, 4);
+	fail |= test_energy(efp, "point charges");
+
+	opts.disable_stress = 1;
+	check(efp_set_opts(efp, &opts));
+	fail |= test_energy(efp, "disable_stress");
+
+#ifdef _OPENMP
+	omp_set_num_threads(omp_get_max_threads() + 2);
+#endif
+	set_point_charges(efp, 3);
+	fail |= test_energy(efp, "threads");
+
+	efp_shutdown(efp);
+
+	printf("%s: qm_wf\n", fail ? "FAILURE" : "SUCCESS");
+	return fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}